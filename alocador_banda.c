@@ -0,0 +1,88 @@
+// alocador_banda.c
+// Divisão max-min justa e ponderada da vazão entre as transferências ativas
+
+#include "alocador_banda.h"
+
+void alocador_iniciar(AlocadorBanda *a, double maximo_kBps) {
+    pthread_mutex_init(&a->trava, NULL);
+    a->maximo = maximo_kBps;
+    a->peso_livre = 0;
+    a->banda_limitada = 0;
+    a->ativas = 0;
+    atomic_init(&a->fator, 1.0);
+    atomic_init(&a->geracao, 0);
+}
+
+// Com a trava: o que as limitadas não usam é dividido entre as livres pelo peso
+static void recalcular(AlocadorBanda *a) {
+    double fator = 1.0;
+    if (a->peso_livre > 0) {
+        fator = (a->maximo - a->banda_limitada) / a->peso_livre;
+        if (fator < 1.0) fator = 1.0; // nunca abaixo do piso reservado na admissão
+    }
+    atomic_store_explicit(&a->fator, fator, memory_order_relaxed);
+    atomic_fetch_add_explicit(&a->geracao, 1, memory_order_release);
+}
+
+static void somar(AlocadorBanda *a, const FatiaBanda *f, double sinal) {
+    if (f->demanda > 0) a->banda_limitada += sinal * f->demanda;
+    else a->peso_livre += sinal * f->peso;
+}
+
+void alocador_entrar(AlocadorBanda *a, FatiaBanda *f, double peso) {
+    f->peso = peso;
+    f->demanda = 0;
+    f->ativa = 1;
+    pthread_mutex_lock(&a->trava);
+    somar(a, f, 1);
+    a->ativas++;
+    recalcular(a);
+    pthread_mutex_unlock(&a->trava);
+}
+
+void alocador_sair(AlocadorBanda *a, FatiaBanda *f) {
+    if (!f->ativa) return;
+    pthread_mutex_lock(&a->trava);
+    somar(a, f, -1);
+    if (--a->ativas == 0) a->peso_livre = a->banda_limitada = 0; // zera o erro acumulado
+    recalcular(a);
+    pthread_mutex_unlock(&a->trava);
+    f->ativa = 0;
+}
+
+void alocador_ajustar_peso(AlocadorBanda *a, FatiaBanda *f, double peso) {
+    if (!f->ativa) return;
+    pthread_mutex_lock(&a->trava);
+    somar(a, f, -1);
+    f->peso = peso;
+    somar(a, f, 1);
+    recalcular(a);
+    pthread_mutex_unlock(&a->trava);
+}
+
+void alocador_limitar(AlocadorBanda *a, FatiaBanda *f, double demanda) {
+    if (!f->ativa) return;
+    if (demanda > 0 && demanda < f->peso) demanda = f->peso; // o piso continua garantido
+    pthread_mutex_lock(&a->trava);
+    somar(a, f, -1);
+    f->demanda = demanda;
+    somar(a, f, 1);
+    recalcular(a);
+    pthread_mutex_unlock(&a->trava);
+}
+
+double alocador_taxa(AlocadorBanda *a, const FatiaBanda *f) {
+    if (f->demanda > 0) return f->demanda;
+    return f->peso * atomic_load_explicit(&a->fator, memory_order_relaxed);
+}
+
+uint64_t alocador_geracao(AlocadorBanda *a) {
+    return atomic_load_explicit(&a->geracao, memory_order_acquire);
+}
+
+double alocador_total(AlocadorBanda *a) {
+    pthread_mutex_lock(&a->trava);
+    double total = a->banda_limitada + a->peso_livre * atomic_load_explicit(&a->fator, memory_order_relaxed);
+    pthread_mutex_unlock(&a->trava);
+    return total;
+}
@@ -0,0 +1,43 @@
+// alocador_banda.h
+// Divisão max-min justa e ponderada da vazão do servidor entre as transferências ativas.
+// A taxa de QoS de cada cliente é o peso e o piso garantido (já reservado na admissão);
+// a sobra é repartida na proporção dos pesos. Transferências que não conseguem usar a sua
+// parte (socket cheio) ficam limitadas à taxa que alcançam e o resto vai para as demais.
+// Cada mudança incrementa a geração; os ritmadores comparam a geração ao acordar
+
+#ifndef ALOCADOR_BANDA_H
+#define ALOCADOR_BANDA_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+typedef struct {
+    double peso;     // taxa de QoS (kB/s)
+    double demanda;  // kB/s que a transferência alcança; 0 = sem limite conhecido
+    int ativa;
+} FatiaBanda;
+
+typedef struct {
+    pthread_mutex_t trava;
+    double maximo;          // kB/s
+    double peso_livre;      // soma dos pesos das transferências sem limite de demanda
+    double banda_limitada;  // soma das taxas das transferências limitadas
+    int ativas;
+    _Atomic double fator;   // taxa de uma transferência livre = peso * fator (>= 1)
+    atomic_uint_fast64_t geracao;
+} AlocadorBanda;
+
+void alocador_iniciar(AlocadorBanda *a, double maximo_kBps);
+void alocador_entrar(AlocadorBanda *a, FatiaBanda *f, double peso);
+void alocador_sair(AlocadorBanda *a, FatiaBanda *f);
+void alocador_ajustar_peso(AlocadorBanda *a, FatiaBanda *f, double peso);
+// Marca a transferência como limitada a 'demanda' kB/s (0 volta a ser livre)
+void alocador_limitar(AlocadorBanda *a, FatiaBanda *f, double demanda);
+// Taxa atual da transferência (sem trava)
+double alocador_taxa(AlocadorBanda *a, const FatiaBanda *f);
+uint64_t alocador_geracao(AlocadorBanda *a);
+// Soma das taxas distribuídas agora
+double alocador_total(AlocadorBanda *a);
+
+#endif
@@ -0,0 +1,185 @@
+// anel_io.c
+// io_uring sem liburing: syscalls diretas e os anéis mapeados em memória
+
+#define _GNU_SOURCE
+#include "anel_io.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Operações que o servidor submete: sem qualquer uma delas, fica no epoll
+static const uint8_t ops_necessarias[] = {
+    IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_SENDMSG, IORING_OP_SPLICE,
+    IORING_OP_TIMEOUT, IORING_OP_TIMEOUT_REMOVE, IORING_OP_POLL_ADD,
+};
+
+static int sys_setup(unsigned entradas, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entradas, p);
+}
+
+static int sys_enter(int fd, unsigned submeter, unsigned minimo, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submeter, minimo, flags, NULL, 0);
+}
+
+static int sys_register(int fd, unsigned op, void *arg, unsigned n) {
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, n);
+}
+
+static int conferir_operacoes(AnelIO *a) {
+    size_t tam = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, tam);
+    if (!probe) return -1;
+    int ok = sys_register(a->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; ok && i < sizeof(ops_necessarias); i++) {
+        uint8_t op = ops_necessarias[i];
+        ok = op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    if (!ok) errno = ENOSYS;
+    return ok ? 0 : -1;
+}
+
+int anel_iniciar(AnelIO *a, unsigned entradas) {
+    memset(a, 0, sizeof(*a));
+    a->fd = -1;
+
+    // COOP_TASKRUN evita interrupções entre threads; kernels antigos não o conhecem
+    struct io_uring_params p = { .flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_CLAMP };
+    int fd = sys_setup(entradas, &p);
+    if (fd < 0 && errno == EINVAL) {
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CLAMP;
+        fd = sys_setup(entradas, &p);
+    }
+    if (fd < 0) return -1;
+    a->fd = fd;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP)) {
+        anel_liberar(a);
+        errno = ENOSYS;
+        return -1;
+    }
+
+    a->sq_tam = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    a->cq_tam = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (a->cq_tam > a->sq_tam) a->sq_tam = a->cq_tam;
+    a->sq_ptr = mmap(NULL, a->sq_tam, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (a->sq_ptr == MAP_FAILED) {
+        a->sq_ptr = NULL;
+        anel_liberar(a);
+        return -1;
+    }
+    a->cq_ptr = a->sq_ptr; // FEAT_SINGLE_MMAP: os dois anéis no mesmo mapeamento
+    a->sqes_tam = p.sq_entries * sizeof(struct io_uring_sqe);
+    a->sqes = mmap(NULL, a->sqes_tam, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (a->sqes == MAP_FAILED) {
+        a->sqes = NULL;
+        anel_liberar(a);
+        return -1;
+    }
+
+    char *sq = a->sq_ptr, *cq = a->cq_ptr;
+    a->sq_head = (unsigned *)(sq + p.sq_off.head);
+    a->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    a->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    a->sq_array = (unsigned *)(sq + p.sq_off.array);
+    a->sq_entradas = p.sq_entries;
+    a->cq_head = (unsigned *)(cq + p.cq_off.head);
+    a->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    a->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    a->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    if (conferir_operacoes(a) < 0) {
+        anel_liberar(a);
+        return -1;
+    }
+    return 0;
+}
+
+void anel_liberar(AnelIO *a) {
+    if (a->bufs) munmap(a->bufs, a->buf_num * sizeof(struct io_uring_buf));
+    free(a->buf_mem);
+    if (a->sqes) munmap(a->sqes, a->sqes_tam);
+    if (a->sq_ptr) munmap(a->sq_ptr, a->sq_tam);
+    if (a->fd >= 0) close(a->fd);
+    memset(a, 0, sizeof(*a));
+    a->fd = -1;
+}
+
+struct io_uring_sqe *anel_sqe(AnelIO *a) {
+    unsigned cauda = *a->sq_tail;
+    if (cauda - __atomic_load_n(a->sq_head, __ATOMIC_ACQUIRE) == a->sq_entradas) {
+        anel_submeter(a, 0); // anel cheio: entrega ao kernel para abrir espaço
+        if (cauda - __atomic_load_n(a->sq_head, __ATOMIC_ACQUIRE) == a->sq_entradas) return NULL;
+    }
+    unsigned i = cauda & *a->sq_mask;
+    struct io_uring_sqe *sqe = &a->sqes[i];
+    memset(sqe, 0, sizeof(*sqe));
+    a->sq_array[i] = i;
+    __atomic_store_n(a->sq_tail, cauda + 1, __ATOMIC_RELEASE);
+    a->a_submeter++;
+    return sqe;
+}
+
+int anel_submeter(AnelIO *a, unsigned minimo) {
+    unsigned n = a->a_submeter;
+    int r;
+    do {
+        r = sys_enter(a->fd, n, minimo, minimo ? IORING_ENTER_GETEVENTS : 0);
+    } while (r < 0 && errno == EINTR && minimo == 0);
+    if (r >= 0) a->a_submeter -= (unsigned)r < n ? (unsigned)r : n;
+    return r;
+}
+
+struct io_uring_cqe *anel_conclusao(AnelIO *a) {
+    unsigned cabeca = *a->cq_head;
+    if (cabeca == __atomic_load_n(a->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &a->cqes[cabeca & *a->cq_mask];
+}
+
+void anel_avancar(AnelIO *a) {
+    __atomic_store_n(a->cq_head, *a->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// Anel de buffers (PBUF_RING) existe desde o 5.19, junto com o accept multishot: a falha aqui
+// também denuncia um kernel sem multishot
+int anel_buffers_iniciar(AnelIO *a, uint16_t grupo, unsigned num, unsigned tam) {
+    size_t tam_anel = num * sizeof(struct io_uring_buf);
+    void *anel = mmap(NULL, tam_anel, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (anel == MAP_FAILED) return -1;
+    char *mem = malloc((size_t)num * tam);
+    if (!mem) {
+        munmap(anel, tam_anel);
+        return -1;
+    }
+    struct io_uring_buf_reg reg = { .ring_addr = (uint64_t)(uintptr_t)anel, .ring_entries = num, .bgid = grupo };
+    if (sys_register(a->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(anel, tam_anel);
+        free(mem);
+        return -1;
+    }
+    a->bufs = anel;
+    a->buf_mem = mem;
+    a->buf_num = num;
+    a->buf_tam = tam;
+    a->buf_grupo = grupo;
+    a->bufs->tail = 0;
+    for (unsigned i = 0; i < num; i++) anel_devolver_buffer(a, (uint16_t)i);
+    return 0;
+}
+
+char *anel_buffer(AnelIO *a, uint16_t id) {
+    return a->buf_mem + (size_t)id * a->buf_tam;
+}
+
+void anel_devolver_buffer(AnelIO *a, uint16_t id) {
+    uint16_t cauda = a->bufs->tail;
+    struct io_uring_buf *b = &a->bufs->bufs[cauda & (a->buf_num - 1)];
+    b->addr = (uint64_t)(uintptr_t)anel_buffer(a, id);
+    b->len = a->buf_tam;
+    b->bid = id;
+    __atomic_store_n(&a->bufs->tail, (uint16_t)(cauda + 1), __ATOMIC_RELEASE);
+}
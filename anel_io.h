@@ -0,0 +1,51 @@
+// anel_io.h
+// io_uring sem liburing: montagem dos anéis por syscalls, submissão, conclusões e o anel de
+// buffers fornecidos (o kernel escolhe onde gravar cada recv)
+
+#ifndef ANEL_IO_H
+#define ANEL_IO_H
+
+#include <linux/io_uring.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    int fd;
+    // Anel de submissão
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_entradas;
+    unsigned a_submeter;    // SQEs preenchidas e ainda não entregues ao kernel
+    // Anel de conclusão
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    // Mapeamentos (liberados em anel_liberar)
+    void *sq_ptr, *cq_ptr;
+    size_t sq_tam, cq_tam, sqes_tam;
+    // Buffers fornecidos
+    struct io_uring_buf_ring *bufs;
+    char *buf_mem;
+    unsigned buf_num, buf_tam;
+    uint16_t buf_grupo;
+} AnelIO;
+
+// Cria o anel e confere se o kernel tem as operações usadas pelo servidor
+// (accept, recv, send, sendmsg, splice, timeout, poll). Retorna -1 com errno se não tiver
+int anel_iniciar(AnelIO *a, unsigned entradas);
+void anel_liberar(AnelIO *a);
+
+// Próxima SQE livre, já zerada (entrega as pendentes ao kernel se o anel encheu)
+struct io_uring_sqe *anel_sqe(AnelIO *a);
+// Entrega as SQEs pendentes e espera ao menos 'minimo' conclusões
+int anel_submeter(AnelIO *a, unsigned minimo);
+// Conclusão mais antiga ainda não consumida (NULL se não há); anel_avancar a consome
+struct io_uring_cqe *anel_conclusao(AnelIO *a);
+void anel_avancar(AnelIO *a);
+
+// Registra 'num' buffers de 'tam' bytes no grupo dado (num potência de 2)
+int anel_buffers_iniciar(AnelIO *a, uint16_t grupo, unsigned num, unsigned tam);
+char *anel_buffer(AnelIO *a, uint16_t id);
+// Devolve o buffer ao kernel depois que os dados foram consumidos
+void anel_devolver_buffer(AnelIO *a, uint16_t id);
+
+#endif
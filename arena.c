@@ -0,0 +1,75 @@
+// arena.c
+// Slabs por thread e arena de buffers em classes de tamanho
+
+#include "arena.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define LINHA_CACHE 64
+#define BLOCO_ARENA (256 * 1024) // bytes de cada mmap das classes da arena
+
+static const size_t tamanhos_classe[ARENA_CLASSES] = { 512, 2048, 4096, 16384, 65536 };
+
+int slab_iniciar(Slab *s, size_t tam_obj, size_t por_bloco) {
+    if (tam_obj < sizeof(NoLivre)) tam_obj = sizeof(NoLivre);
+    s->tam_obj = (tam_obj + LINHA_CACHE - 1) & ~(size_t)(LINHA_CACHE - 1);
+    s->por_bloco = por_bloco > 0 ? por_bloco : 1;
+    s->livres = NULL;
+    s->bloco = NULL;
+    s->usados_bloco = s->por_bloco; // o primeiro slab_obter mapeia o primeiro bloco
+    s->em_uso = s->reservados = 0;
+    return 0;
+}
+
+void *slab_obter(Slab *s) {
+    NoLivre *n = s->livres;
+    if (n) {
+        s->livres = n->prox;
+        s->em_uso++;
+        return n;
+    }
+    if (s->usados_bloco == s->por_bloco) {
+        void *bloco = mmap(NULL, s->tam_obj * s->por_bloco, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (bloco == MAP_FAILED) return NULL;
+        s->bloco = bloco;
+        s->usados_bloco = 0;
+        s->reservados += s->por_bloco;
+    }
+    s->em_uso++;
+    return s->bloco + s->tam_obj * s->usados_bloco++;
+}
+
+void slab_devolver(Slab *s, void *obj) {
+    NoLivre *n = obj;
+    n->prox = s->livres;
+    s->livres = n;
+    s->em_uso--;
+}
+
+int arena_iniciar(ArenaBuffers *a) {
+    for (int k = 0; k < ARENA_CLASSES; k++)
+        slab_iniciar(&a->classe[k], tamanhos_classe[k], BLOCO_ARENA / tamanhos_classe[k]);
+    return 0;
+}
+
+static int classe_de(size_t tam) {
+    for (int k = 0; k < ARENA_CLASSES; k++)
+        if (tam <= tamanhos_classe[k]) return k;
+    return -1;
+}
+
+void *arena_obter(ArenaBuffers *a, size_t tam) {
+    int k = classe_de(tam);
+    return k >= 0 ? slab_obter(&a->classe[k]) : malloc(tam);
+}
+
+void arena_devolver(ArenaBuffers *a, void *p, size_t tam) {
+    if (!p) return;
+    int k = classe_de(tam);
+    if (k >= 0)
+        slab_devolver(&a->classe[k], p);
+    else
+        free(p);
+}
@@ -0,0 +1,44 @@
+// arena.h
+// Memória por thread sem passar pelo heap global: slabs de objetos de tamanho fixo (conexões) e
+// uma arena de buffers em classes de tamanho (requisições e respostas). Os blocos vêm do mmap e
+// nunca são devolvidos; objetos liberados voltam para a lista livre e são reaproveitados primeiro,
+// então sob rotatividade constante a memória residente fica estável. Sem trava: só a thread dona
+// obtém e devolve
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct NoLivre {
+    struct NoLivre *prox;
+} NoLivre;
+
+typedef struct {
+    size_t tam_obj;      // arredondado para a linha de cache
+    size_t por_bloco;    // objetos em cada mmap
+    NoLivre *livres;     // devolvidos, reaproveitados antes de avançar no bloco
+    char *bloco;         // bloco atual; as páginas só são tocadas quando um objeto novo é entregue
+    size_t usados_bloco;
+    size_t em_uso, reservados; // objetos entregues / objetos com memória reservada
+} Slab;
+
+int slab_iniciar(Slab *s, size_t tam_obj, size_t por_bloco);
+// Objeto do slab (conteúdo indefinido). NULL se o mmap de um bloco novo falhar
+void *slab_obter(Slab *s);
+void slab_devolver(Slab *s, void *obj);
+
+#define ARENA_CLASSES 5 // 512 B, 2 KB, 4 KB, 16 KB e 64 KB
+
+typedef struct {
+    Slab classe[ARENA_CLASSES];
+} ArenaBuffers;
+
+int arena_iniciar(ArenaBuffers *a);
+// Buffer de pelo menos 'tam' bytes, da menor classe que o comporta. Acima da maior classe
+// (fora do caminho das requisições, como um /metrics enorme) recorre ao malloc
+void *arena_obter(ArenaBuffers *a, size_t tam);
+// 'tam' deve ser o mesmo pedido em arena_obter
+void arena_devolver(ArenaBuffers *a, void *p, size_t tam);
+
+#endif
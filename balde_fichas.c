@@ -0,0 +1,40 @@
+// balde_fichas.c
+// Balde de fichas para controle de banda por conexão
+
+#include "balde_fichas.h"
+
+static void repor(BaldeFichas *b, uint64_t agora_us) {
+    if (agora_us > b->ultimo_us) {
+        b->fichas += (agora_us - b->ultimo_us) * b->taxa_Bps / 1e6;
+        if (b->fichas > b->capacidade) b->fichas = b->capacidade;
+    }
+    b->ultimo_us = agora_us;
+}
+
+void balde_iniciar(BaldeFichas *b, double taxa_kBps, size_t rajada_bytes, uint64_t agora_us) {
+    b->taxa_Bps = taxa_kBps * 1024.0;
+    b->capacidade = (double)rajada_bytes;
+    b->fichas = 0;
+    b->ultimo_us = agora_us;
+}
+
+void balde_ajustar_taxa(BaldeFichas *b, double taxa_kBps, uint64_t agora_us) {
+    repor(b, agora_us);
+    b->taxa_Bps = taxa_kBps * 1024.0;
+}
+
+size_t balde_disponivel(BaldeFichas *b, uint64_t agora_us) {
+    repor(b, agora_us);
+    return b->fichas > 0 ? (size_t)b->fichas : 0;
+}
+
+void balde_consumir(BaldeFichas *b, size_t bytes) {
+    b->fichas -= (double)bytes;
+}
+
+uint64_t balde_espera_us(BaldeFichas *b, size_t bytes, uint64_t agora_us) {
+    repor(b, agora_us);
+    if (b->fichas >= (double)bytes) return 0;
+    if (b->taxa_Bps <= 0) return UINT64_MAX;
+    return (uint64_t)(((double)bytes - b->fichas) * 1e6 / b->taxa_Bps) + 1;
+}
@@ -0,0 +1,26 @@
+// balde_fichas.h
+// Balde de fichas para controle de banda por conexão
+
+#ifndef BALDE_FICHAS_H
+#define BALDE_FICHAS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    double taxa_Bps;    // reposição em bytes por segundo
+    double capacidade;  // rajada máxima em bytes
+    double fichas;      // bytes que podem ser enviados agora
+    uint64_t ultimo_us; // instante da última reposição
+} BaldeFichas;
+
+// O balde começa vazio: a taxa média medida desde o primeiro byte fica igual à configurada
+void balde_iniciar(BaldeFichas *b, double taxa_kBps, size_t rajada_bytes, uint64_t agora_us);
+// Troca a taxa sem perder as fichas já acumuladas
+void balde_ajustar_taxa(BaldeFichas *b, double taxa_kBps, uint64_t agora_us);
+size_t balde_disponivel(BaldeFichas *b, uint64_t agora_us);
+void balde_consumir(BaldeFichas *b, size_t bytes);
+// Microssegundos até haver 'bytes' fichas (0 se já há; UINT64_MAX se a taxa é nula)
+uint64_t balde_espera_us(BaldeFichas *b, size_t bytes, uint64_t agora_us);
+
+#endif
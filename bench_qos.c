@@ -0,0 +1,140 @@
+// bench_qos.c
+// Confere a trie de QoS contra uma busca linear e mede a busca com 1 milhão de regras
+// Compilação: gcc -O2 bench_qos.c qos.c -o bench_qos
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "qos.h"
+
+#define TAXA_PADRAO 1000
+
+typedef struct {
+    uint32_t rede;
+    int prefixo;
+    double taxa;
+} Regra;
+
+static double agora_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t aleatorio32(void) {
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static uint32_t mascara(int prefixo) {
+    return prefixo ? ~0u << (32 - prefixo) : 0;
+}
+
+// Prefixos de /8 a /32, a maioria /16 a /24 como numa tabela real
+static void gerar(Regra *r, size_t n) {
+    static const int prefixos[] = { 8, 12, 16, 16, 20, 22, 24, 24, 24, 24, 24, 28, 32 };
+    for (size_t i = 0; i < n; i++) {
+        r[i].prefixo = prefixos[rand() % (int)(sizeof(prefixos) / sizeof(prefixos[0]))];
+        r[i].rede = aleatorio32() & mascara(r[i].prefixo);
+        r[i].taxa = 1 + rand() % 5000;
+    }
+}
+
+static TabelaQoS *montar(const Regra *r, size_t n) {
+    TabelaQoS *t = qos_criar(TAXA_PADRAO);
+    for (size_t i = 0; i < n; i++) {
+        uint8_t end[4] = { r[i].rede >> 24, r[i].rede >> 16, r[i].rede >> 8, r[i].rede };
+        qos_adicionar(t, AF_INET, end, r[i].prefixo, r[i].taxa);
+    }
+    if (qos_construir(t) != 0) {
+        fprintf(stderr, "Falha ao construir a trie com %zu regras\n", n);
+        exit(1);
+    }
+    return t;
+}
+
+// Referência: prefixo mais longo; entre iguais, a última regra
+static double buscar_linear(const Regra *r, size_t n, uint32_t ip) {
+    int melhor = -1;
+    double taxa = TAXA_PADRAO;
+    for (size_t i = 0; i < n; i++) {
+        if ((ip & mascara(r[i].prefixo)) == r[i].rede && r[i].prefixo >= melhor) {
+            melhor = r[i].prefixo;
+            taxa = r[i].taxa;
+        }
+    }
+    return taxa;
+}
+
+static int conferir(size_t n, int consultas) {
+    Regra *r = malloc(n * sizeof(Regra));
+    gerar(r, n);
+    TabelaQoS *t = montar(r, n);
+    for (int i = 0; i < consultas; i++) {
+        // Metade das consultas cai dentro de uma regra existente
+        uint32_t ip = (i & 1) ? aleatorio32() : (r[rand() % n].rede | (aleatorio32() & ~mascara(r[rand() % n].prefixo)));
+        if (qos_buscar_v4(t, ip) != buscar_linear(r, n, ip)) {
+            fprintf(stderr, "Divergência em %u.%u.%u.%u\n", ip >> 24, (ip >> 16) & 255, (ip >> 8) & 255, ip & 255);
+            return 1;
+        }
+    }
+
+    // IPv6: /32 dentro de /16 e um host dentro do /32
+    TabelaQoS *t6 = qos_criar(TAXA_PADRAO);
+    uint8_t rede[16] = { 0x20, 0x01, 0x0d, 0xb8 }, host[16];
+    qos_adicionar(t6, AF_INET6, rede, 16, 10);
+    qos_adicionar(t6, AF_INET6, rede, 32, 20);
+    memcpy(host, rede, 16);
+    host[15] = 1;
+    qos_adicionar(t6, AF_INET6, host, 128, 30);
+    qos_construir(t6);
+    uint8_t outro[16] = { 0x20, 0x01, 0xff };
+    host[14] = 1;
+    if (qos_buscar_v6(t6, outro) != 10 || qos_buscar_v6(t6, host) != 20 ||
+        (host[14] = 0, qos_buscar_v6(t6, host)) != 30 || qos_buscar_v6(t6, (uint8_t[16]){ 0 }) != TAXA_PADRAO) {
+        fprintf(stderr, "Divergência na busca IPv6\n");
+        return 1;
+    }
+    qos_liberar(t6);
+    qos_liberar(t);
+    free(r);
+    return 0;
+}
+
+static void medir(size_t n, long buscas) {
+    Regra *r = malloc(n * sizeof(Regra));
+    gerar(r, n);
+    double inicio = agora_s();
+    TabelaQoS *t = montar(r, n);
+    double construcao = agora_s() - inicio;
+
+    // Endereços aleatórios pré-gerados: quase toda busca sai do cache
+    size_t amostras = 1 << 20;
+    uint32_t *ips = malloc(amostras * sizeof(uint32_t));
+    for (size_t i = 0; i < amostras; i++)
+        ips[i] = (i & 1) ? aleatorio32() : (r[rand() % n].rede | (aleatorio32() & 0xff));
+
+    inicio = agora_s();
+    double soma = 0;
+    for (long i = 0; i < buscas; i++)
+        soma += qos_buscar_v4(t, ips[(size_t)i & (amostras - 1)]);
+    double duracao = agora_s() - inicio;
+
+    printf("%7zu regras: construção %.1f ms, busca %.1f ns [%.0f]\n",
+           n, construcao * 1e3, duracao * 1e9 / buscas, soma / buscas);
+    qos_liberar(t);
+    free(ips);
+    free(r);
+}
+
+int main(int argc, char *argv[]) {
+    long buscas = (argc > 1) ? atol(argv[1]) : 20000000;
+    srand(42);
+    if (conferir(5000, 20000) != 0) return 1;
+    medir(1000, buscas);
+    medir(1000000, buscas);
+    return 0;
+}
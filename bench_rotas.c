@@ -0,0 +1,81 @@
+// bench_rotas.c
+// Mede a busca na tabela de rotas com 1 mil e 100 mil rotas: o custo deve ficar constante
+// Compilação: gcc -O2 bench_rotas.c rotas.c cache_arquivos.c -o bench_rotas -lpthread -lz -lbrotlienc
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rotas.h"
+
+static double agora_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int medir(size_t num_rotas, long buscas) {
+    TabelaRotas t;
+    rotas_iniciar(&t);
+    char caminho[64];
+    // O asset é só um marcador aqui: o valor (i + 1) identifica a rota
+    for (size_t i = 0; i < num_rotas; i++) {
+        snprintf(caminho, sizeof(caminho), "/fotos/album%zu/foto_%zu.jpg", i % 97, i);
+        rotas_adicionar(&t, caminho, (Asset *)(i + 1));
+    }
+    rotas_adicionar(&t, "/galeria/*", (Asset *)(num_rotas + 1));
+
+    double inicio = agora_s();
+    if (rotas_construir(&t) != 0) {
+        fprintf(stderr, "Falha ao construir a tabela com %zu rotas\n", num_rotas);
+        return 1;
+    }
+    double construcao = agora_s() - inicio;
+
+    // Conferência: todas as rotas encontram o próprio asset; inexistentes não encontram nada
+    for (size_t i = 0; i < num_rotas; i++) {
+        int n = snprintf(caminho, sizeof(caminho), "/fotos/album%zu/foto_%zu.jpg", i % 97, i);
+        if (rotas_buscar(&t, caminho, n) != (Asset *)(i + 1)) {
+            fprintf(stderr, "Rota %s não encontrada\n", caminho);
+            return 1;
+        }
+    }
+    if (rotas_buscar(&t, "/nada.jpg", 9) != NULL ||
+        rotas_buscar(&t, "/galeria/x.jpg", 14) != (Asset *)(num_rotas + 1)) {
+        fprintf(stderr, "Busca de rota inexistente ou de prefixo incorreta\n");
+        return 1;
+    }
+
+    // Caminhos pré-gerados fora da medição
+    size_t amostras = 4096;
+    char (*caminhos)[64] = malloc(amostras * sizeof(*caminhos));
+    size_t *lens = malloc(amostras * sizeof(size_t));
+    srand(42);
+    for (size_t i = 0; i < amostras; i++) {
+        size_t r = (size_t)rand() % num_rotas;
+        lens[i] = snprintf(caminhos[i], 64, "/fotos/album%zu/foto_%zu.jpg", r % 97, r);
+    }
+
+    inicio = agora_s();
+    size_t soma = 0;
+    for (long i = 0; i < buscas; i++) {
+        size_t k = (size_t)i & (amostras - 1);
+        soma += (size_t)rotas_buscar(&t, caminhos[k], lens[k]);
+    }
+    double duracao = agora_s() - inicio;
+
+    printf("%7zu rotas: construção %.1f ms, busca %.1f ns [%zu]\n",
+           num_rotas, construcao * 1e3, duracao * 1e9 / buscas, soma & 1);
+    free(caminhos);
+    free(lens);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    long buscas = (argc > 1) ? atol(argv[1]) : 20000000;
+    if (medir(1000, buscas) != 0) return 1;
+    if (medir(100000, buscas) != 0) return 1;
+    return 0;
+}
@@ -0,0 +1,377 @@
+// cache_arquivos.c
+// Cache dos arquivos servidos com cabeçalhos prontos e invalidação por inotify/mtime
+
+#define _GNU_SOURCE
+#include "cache_arquivos.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <brotli/encode.h>
+#include <zlib.h>
+
+#define CACHE_COMPRIMIR_MIN 256        // abaixo disso a compressão não compensa o cabeçalho
+#define CACHE_COMPRIMIR_MAX (64 << 20) // acima disso a compressão atrasaria demais a carga
+
+static Asset **assets = NULL;
+static size_t num_assets = 0, cap_assets = 0;
+static pthread_mutex_t trava_lista = PTHREAD_MUTEX_INITIALIZER;
+static char controle[48] = "public, max-age=60"; // padrão: 1 minuto
+
+void cache_definir_validade(int segundos) {
+    snprintf(controle, sizeof(controle), "public, max-age=%d", segundos < 0 ? 0 : segundos);
+}
+
+const char *cache_controle(void) {
+    return controle;
+}
+
+static const char *tipo_por_extensao(const char *arquivo) {
+    const char *ext = strrchr(arquivo, '.');
+    if (!ext) return "application/octet-stream";
+    if (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0) return "image/jpeg";
+    if (strcasecmp(ext, ".png") == 0) return "image/png";
+    if (strcasecmp(ext, ".gif") == 0) return "image/gif";
+    if (strcasecmp(ext, ".html") == 0 || strcasecmp(ext, ".htm") == 0) return "text/html; charset=utf-8";
+    if (strcasecmp(ext, ".txt") == 0) return "text/plain; charset=utf-8";
+    if (strcasecmp(ext, ".css") == 0) return "text/css";
+    if (strcasecmp(ext, ".js") == 0) return "application/javascript";
+    if (strcasecmp(ext, ".json") == 0) return "application/json";
+    return "application/octet-stream";
+}
+
+// FNV-1a de 64 bits: barato e suficiente para distinguir versões de um arquivo
+static uint64_t hash_conteudo(const char *dados, size_t tamanho) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < tamanho; i++) {
+        h ^= (unsigned char)dados[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static char *montar_cabecalho(const Asset *a, const VersaoAsset *v, const Representacao *r,
+                              const char *conexao, size_t *len) {
+    char buf[512];
+    int n = snprintf(buf, sizeof(buf),
+                     "HTTP/1.1 200 OK\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %zu\r\n"
+                     "%s"
+                     "ETag: %s\r\n"
+                     "Last-Modified: %s\r\n"
+                     "Cache-Control: %s\r\n"
+                     "Accept-Ranges: bytes\r\n"
+                     "Connection: %s\r\n"
+                     "\r\n",
+                     a->tipo, r->tamanho, r->cab_codificacao, r->etag, v->modificado, controle, conexao);
+    char *cab = malloc(n + 1);
+    if (cab) memcpy(cab, buf, n + 1);
+    *len = n;
+    return cab;
+}
+
+static void destruir_versao(VersaoAsset *v) {
+    for (int k = 0; k < NUM_CODIFICACOES; k++) { // v->corpo é o mapeamento da identidade
+        if (v->rep[k].dados) munmap((void *)v->rep[k].dados, v->rep[k].tamanho);
+        if (v->rep[k].fd >= 0) close(v->rep[k].fd);
+        free(v->rep[k].cab_viva);
+        free(v->rep[k].cab_fechar);
+    }
+    free(v);
+}
+
+static int comprimivel(const char *tipo) {
+    return strncmp(tipo, "text/", 5) == 0 || strcmp(tipo, "application/javascript") == 0 ||
+           strcmp(tipo, "application/json") == 0;
+}
+
+// gzip no nível máximo: a compressão acontece uma vez por versão, o envio é que se repete
+static size_t comprimir_gzip(const char *dados, size_t tamanho, unsigned char **saida) {
+    z_stream z = {0};
+    if (deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) return 0;
+    size_t cap = deflateBound(&z, tamanho);
+    *saida = malloc(cap);
+    size_t n = 0;
+    if (*saida) {
+        z.next_in = (unsigned char *)dados;
+        z.avail_in = tamanho;
+        z.next_out = *saida;
+        z.avail_out = cap;
+        if (deflate(&z, Z_FINISH) == Z_STREAM_END) n = z.total_out;
+    }
+    deflateEnd(&z);
+    return n;
+}
+
+// Qualidade máxima do brotli é lenta (~1 MB/s): arquivos grandes usam uma um pouco menor
+static size_t comprimir_brotli(const char *dados, size_t tamanho, unsigned char **saida) {
+    size_t n = BrotliEncoderMaxCompressedSize(tamanho);
+    *saida = n ? malloc(n) : NULL;
+    if (!*saida) return 0;
+    int qualidade = tamanho <= (1 << 20) ? BROTLI_MAX_QUALITY : 9;
+    if (!BrotliEncoderCompress(qualidade, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, tamanho,
+                               (const uint8_t *)dados, &n, *saida))
+        return 0;
+    return n;
+}
+
+// Guarda o conteúdo num memfd selado: o envio continua sendo sendfile de um descritor, e os bytes
+// servidos sob um ETag não mudam mais, nem se o arquivo for reescrito ou truncado no lugar
+static int criar_variante(Representacao *r, const char *nome, const unsigned char *dados, size_t n) {
+    int fd = memfd_create(nome, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) return -1;
+    size_t escrito = 0;
+    while (escrito < n) {
+        ssize_t w = write(fd, dados + escrito, n - escrito);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            close(fd);
+            return -1;
+        }
+        escrito += w;
+    }
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+        close(fd);
+        return -1;
+    }
+    void *m = n > 0 ? mmap(NULL, n, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0) : NULL;
+    if (m == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    r->fd = fd;
+    r->tamanho = n;
+    r->dados = m;
+    return 0;
+}
+
+static void comprimir_versao(VersaoAsset *v) {
+    static const struct {
+        Codificacao cod;
+        const char *sufixo;
+        size_t (*comprimir)(const char *, size_t, unsigned char **);
+    } metodos[] = { { COD_GZIP, "gz", comprimir_gzip }, { COD_BROTLI, "br", comprimir_brotli } };
+
+    for (size_t i = 0; i < sizeof(metodos) / sizeof(metodos[0]); i++) {
+        Representacao *r = &v->rep[metodos[i].cod];
+        unsigned char *dados = NULL;
+        size_t n = metodos[i].comprimir(v->corpo, v->tamanho, &dados);
+        // Só vale a pena se economiza banda de verdade
+        if (n > 0 && n < v->tamanho - v->tamanho / 10 && criar_variante(r, r->nome, dados, n) == 0)
+            snprintf(r->etag, sizeof(r->etag), "%.17s-%s\"", v->rep[COD_IDENTIDADE].etag, metodos[i].sufixo);
+        free(dados);
+    }
+}
+
+static VersaoAsset *ler_versao(const Asset *a) {
+    int fd = open(a->arquivo, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+
+    VersaoAsset *v = calloc(1, sizeof(VersaoAsset));
+    if (!v) {
+        close(fd);
+        return NULL;
+    }
+    atomic_init(&v->refs, 1); // referência do próprio cache
+    static const char *nomes[NUM_CODIFICACOES] = { "identity", "gzip", "br" };
+    for (int k = 0; k < NUM_CODIFICACOES; k++) {
+        v->rep[k].fd = -1;
+        v->rep[k].nome = nomes[k];
+    }
+    Representacao *id = &v->rep[COD_IDENTIDADE];
+    v->mtime = st.st_mtime;
+    v->ino = st.st_ino;
+    // A versão é uma cópia: o arquivo no disco pode ser reescrito no lugar enquanto ela é servida.
+    // Se ele encolher durante a cópia, o write falha (EFAULT) e a próxima alteração recarrega
+    void *m = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    int copiou = m != MAP_FAILED && criar_variante(id, id->nome, m, st.st_size) == 0;
+    if (m && m != MAP_FAILED) munmap(m, st.st_size);
+    close(fd);
+    if (!copiou) {
+        destruir_versao(v);
+        return NULL;
+    }
+    v->tamanho = id->tamanho;
+    v->corpo = id->dados;
+    v->tipo = a->tipo;
+    struct tm tm;
+    strftime(v->modificado, sizeof(v->modificado), "%a, %d %b %Y %H:%M:%S GMT", gmtime_r(&v->mtime, &tm));
+    snprintf(id->etag, sizeof(id->etag), "\"%016llx\"",
+             (unsigned long long)hash_conteudo(v->corpo, v->tamanho));
+
+    int variantes = 0;
+    if (comprimivel(a->tipo) && v->tamanho >= CACHE_COMPRIMIR_MIN && v->tamanho <= CACHE_COMPRIMIR_MAX) {
+        comprimir_versao(v);
+        variantes = v->rep[COD_GZIP].fd >= 0 || v->rep[COD_BROTLI].fd >= 0;
+    }
+    for (int k = 0; k < NUM_CODIFICACOES; k++) {
+        Representacao *r = &v->rep[k];
+        if (r->fd < 0) continue;
+        // Com variantes, até a resposta sem compressão depende do Accept-Encoding
+        if (k != COD_IDENTIDADE)
+            snprintf(r->cab_codificacao, sizeof(r->cab_codificacao),
+                     "Content-Encoding: %s\r\nVary: Accept-Encoding\r\n", r->nome);
+        else if (variantes)
+            snprintf(r->cab_codificacao, sizeof(r->cab_codificacao), "Vary: Accept-Encoding\r\n");
+        r->cab_viva = montar_cabecalho(a, v, r, "keep-alive", &r->cab_viva_len);
+        r->cab_fechar = montar_cabecalho(a, v, r, "close", &r->cab_fechar_len);
+        if (!r->cab_viva || !r->cab_fechar) {
+            destruir_versao(v);
+            return NULL;
+        }
+    }
+    return v;
+}
+
+Asset *cache_carregar(const char *arquivo) {
+    Asset *a = calloc(1, sizeof(Asset));
+    if (!a) return NULL;
+    snprintf(a->arquivo, sizeof(a->arquivo), "%s", arquivo);
+    a->tipo = tipo_por_extensao(arquivo);
+    a->wd = -1;
+    pthread_mutex_init(&a->trava, NULL);
+    a->atual = ler_versao(a);
+    if (!a->atual)
+        fprintf(stderr, "Aviso: %s indisponível; será carregado quando aparecer\n", arquivo);
+
+    pthread_mutex_lock(&trava_lista);
+    if (num_assets == cap_assets) {
+        size_t cap = cap_assets ? cap_assets * 2 : 16;
+        Asset **novo = realloc(assets, cap * sizeof(Asset *));
+        if (!novo) {
+            pthread_mutex_unlock(&trava_lista);
+            return a; // funciona, só não é vigiado
+        }
+        assets = novo;
+        cap_assets = cap;
+    }
+    assets[num_assets++] = a;
+    pthread_mutex_unlock(&trava_lista);
+    return a;
+}
+
+VersaoAsset *cache_obter(Asset *a) {
+    pthread_mutex_lock(&a->trava);
+    VersaoAsset *v = a->atual;
+    if (v) atomic_fetch_add_explicit(&v->refs, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&a->trava);
+    return v;
+}
+
+void cache_soltar(VersaoAsset *v) {
+    if (v && atomic_fetch_sub_explicit(&v->refs, 1, memory_order_acq_rel) == 1)
+        destruir_versao(v);
+}
+
+void cache_recarregar(Asset *a) {
+    struct stat st;
+    int existe = stat(a->arquivo, &st) == 0;
+
+    pthread_mutex_lock(&a->trava);
+    VersaoAsset *v = a->atual;
+    int igual = existe && v && v->mtime == st.st_mtime && v->ino == st.st_ino &&
+                v->tamanho == (size_t)st.st_size;
+    pthread_mutex_unlock(&a->trava);
+    if (igual || (!existe && !v)) return;
+
+    // Lê fora da trava: as requisições continuam usando a versão antiga enquanto isso
+    VersaoAsset *nova = existe ? ler_versao(a) : NULL;
+    pthread_mutex_lock(&a->trava);
+    VersaoAsset *antiga = a->atual;
+    a->atual = nova;
+    pthread_mutex_unlock(&a->trava);
+    cache_soltar(antiga);
+    printf("Cache: %s %s\n", a->arquivo, nova ? "recarregado" : "removido");
+}
+
+static void recarregar_todos(void) {
+    pthread_mutex_lock(&trava_lista);
+    for (size_t i = 0; i < num_assets; i++)
+        cache_recarregar(assets[i]);
+    pthread_mutex_unlock(&trava_lista);
+}
+
+// Recarrega os assets com este nome no diretório vigiado 'wd'
+static void recarregar_nome(int wd, const char *nome) {
+    pthread_mutex_lock(&trava_lista);
+    for (size_t i = 0; i < num_assets; i++) {
+        const char *base = strrchr(assets[i]->arquivo, '/');
+        base = base ? base + 1 : assets[i]->arquivo;
+        if (assets[i]->wd == wd && strcmp(base, nome) == 0)
+            cache_recarregar(assets[i]);
+    }
+    pthread_mutex_unlock(&trava_lista);
+}
+
+static void *vigiar_mtime(void *arg) {
+    (void)arg;
+    while (1) {
+        sleep(1);
+        recarregar_todos();
+    }
+    return NULL;
+}
+
+static void *vigiar_inotify(void *arg) {
+    int ifd = (int)(intptr_t)arg;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (1) {
+        ssize_t n = read(ifd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            perror("Erro no inotify; usando checagem de mtime");
+            return vigiar_mtime(NULL);
+        }
+        for (char *p = buf; p < buf + n;) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            if (ev->mask & IN_Q_OVERFLOW)
+                recarregar_todos(); // eventos perdidos: confere tudo
+            else if (ev->len > 0)
+                recarregar_nome(ev->wd, ev->name);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    return NULL;
+}
+
+void cache_vigiar(void) {
+    pthread_t t;
+    int ifd = inotify_init1(IN_CLOEXEC);
+    if (ifd >= 0) {
+        pthread_mutex_lock(&trava_lista);
+        int vigiados = 0;
+        for (size_t i = 0; i < num_assets; i++) {
+            char copia[CACHE_MAX_NOME];
+            snprintf(copia, sizeof(copia), "%s", assets[i]->arquivo);
+            // Vigia o diretório: editores costumam substituir o arquivo por rename
+            assets[i]->wd = inotify_add_watch(ifd, dirname(copia), IN_CLOSE_WRITE | IN_MOVED_TO |
+                                              IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ATTRIB);
+            if (assets[i]->wd >= 0) vigiados++;
+        }
+        pthread_mutex_unlock(&trava_lista);
+        if (vigiados > 0 && pthread_create(&t, NULL, vigiar_inotify, (void *)(intptr_t)ifd) == 0) {
+            pthread_detach(t);
+            return;
+        }
+        close(ifd);
+    }
+    if (pthread_create(&t, NULL, vigiar_mtime, NULL) == 0)
+        pthread_detach(t);
+}
@@ -0,0 +1,74 @@
+// cache_arquivos.h
+// Cache dos arquivos servidos: cada versão é uma cópia selada (memfd) e guarda o cabeçalho 200 OK pronto
+// Arquivos de texto ganham também variantes gzip e brotli, comprimidas ao carregar
+// Alterações no disco (inotify, ou checagem de mtime) geram uma nova versão; a antiga é liberada
+// quando a última transferência que a usa termina
+
+#ifndef CACHE_ARQUIVOS_H
+#define CACHE_ARQUIVOS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define CACHE_MAX_NOME 256
+
+typedef enum {
+    COD_IDENTIDADE, // o arquivo como está no disco (sempre presente)
+    COD_GZIP,
+    COD_BROTLI,
+    NUM_CODIFICACOES
+} Codificacao;
+
+// Uma forma de enviar o conteúdo: a cópia do arquivo ou uma variante comprimida, cada uma num
+// memfd selado, que sai pelo mesmo sendfile (e aceita Range sobre os bytes comprimidos)
+typedef struct {
+    int fd;                 // mantido aberto para sendfile; -1 se a variante não existe
+    size_t tamanho;
+    const char *dados;      // o mesmo conteúdo mapeado (trechos pequenos saem por cópia, junto do cabeçalho)
+    const char *nome;       // token do Accept-Encoding ("identity", "gzip", "br")
+    char etag[24];          // hash do conteúdo (com sufixo nas variantes), entre aspas
+    char cab_codificacao[64]; // "Content-Encoding: ...\r\nVary: ...\r\n" ou vazio
+    char *cab_viva;         // "HTTP/1.1 200 OK ... Connection: keep-alive\r\n\r\n"
+    size_t cab_viva_len;
+    char *cab_fechar;       // idem com "Connection: close"
+    size_t cab_fechar_len;
+} Representacao;
+
+// Conteúdo imutável de um arquivo num dado momento
+typedef struct {
+    atomic_int refs;
+    const char *corpo;      // o mesmo mapeamento da identidade (NULL se vazio)
+    size_t tamanho;
+    time_t mtime;
+    ino_t ino;
+    const char *tipo;       // Content-Type (das respostas montadas na hora, como as parciais)
+    char modificado[32];    // Last-Modified (data HTTP do mtime)
+    Representacao rep[NUM_CODIFICACOES];
+} VersaoAsset;
+
+typedef struct {
+    char arquivo[CACHE_MAX_NOME]; // caminho no disco
+    const char *tipo;             // Content-Type
+    int wd;                       // diretório vigiado pelo inotify (-1 se nenhum)
+    pthread_mutex_t trava;        // protege só a troca/obtenção de 'atual'
+    VersaoAsset *atual;           // NULL enquanto o arquivo não existe
+} Asset;
+
+// Tempo que os clientes podem reutilizar a cópia sem revalidar (chamar antes de carregar)
+void cache_definir_validade(int segundos);
+// Validade atual, já formatada para o cabeçalho Cache-Control
+const char *cache_controle(void);
+// Registra e carrega o arquivo (mesmo que ainda não exista). Retorna NULL só sem memória
+Asset *cache_carregar(const char *arquivo);
+// Versão atual com uma referência a mais (NULL se o arquivo não existe)
+VersaoAsset *cache_obter(Asset *a);
+void cache_soltar(VersaoAsset *v);
+// Relê o arquivo se ele mudou no disco
+void cache_recarregar(Asset *a);
+// Inicia a thread que acompanha alterações (inotify; sem ele, checa o mtime a cada segundo)
+void cache_vigiar(void);
+
+#endif
@@ -0,0 +1,155 @@
+// envio.c
+// Transmissão de arquivos sem cópia para o espaço do usuário (sendfile, com splice como reserva)
+
+#define _GNU_SOURCE
+#include "envio.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+
+void envio_iniciar(EnvioArquivo *e, int fd, off_t inicio, off_t fim) {
+    e->fd = fd;
+    e->offset = inicio;
+    e->fim = fim;
+    e->usar_splice = 0;
+    e->pipe_fd[0] = e->pipe_fd[1] = -1;
+    e->no_pipe = 0;
+}
+
+int envio_concluido(const EnvioArquivo *e) {
+    return e->offset >= e->fim && e->no_pipe == 0;
+}
+
+off_t envio_restante(const EnvioArquivo *e) {
+    return (e->fim - e->offset) + (off_t)e->no_pipe;
+}
+
+void envio_liberar(EnvioArquivo *e) {
+    if (e->pipe_fd[0] >= 0) close(e->pipe_fd[0]);
+    if (e->pipe_fd[1] >= 0) close(e->pipe_fd[1]);
+    e->pipe_fd[0] = e->pipe_fd[1] = -1;
+}
+
+int envio_preparar_pipe(EnvioArquivo *e) {
+    if (e->pipe_fd[0] >= 0) return 0;
+    if (pipe2(e->pipe_fd, O_CLOEXEC) < 0) return -1;
+    e->usar_splice = 1;
+    return 0;
+}
+
+void envio_avancar(EnvioArquivo *e, size_t n) {
+    e->offset += (off_t)n;
+}
+
+void envio_reposicionar(EnvioArquivo *e, off_t inicio, off_t fim) {
+    e->offset = inicio;
+    e->fim = fim;
+}
+
+static size_t minimo(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+// Arquivo -> pipe -> socket; o que fica no pipe é enviado na próxima chamada
+static ssize_t transmitir_splice(EnvioArquivo *e, int sock, size_t max) {
+    size_t total = 0;
+    while (total < max) {
+        if (e->no_pipe == 0) {
+            if (e->offset >= e->fim) break;
+            size_t pedir = minimo(minimo(max - total, (size_t)(e->fim - e->offset)), CAPACIDADE_PIPE);
+            ssize_t n = splice(e->fd, &e->offset, e->pipe_fd[1], NULL, pedir, SPLICE_F_MOVE);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                if (n == 0) errno = EIO; // arquivo encolheu durante o envio
+                return total > 0 ? (ssize_t)total : -1;
+            }
+            e->no_pipe = n;
+        }
+        ssize_t n = splice(e->pipe_fd[0], NULL, sock, NULL, minimo(e->no_pipe, max - total),
+                           SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return total > 0 ? (ssize_t)total : -1;
+        e->no_pipe -= n;
+        total += n;
+    }
+    return total;
+}
+
+ssize_t envio_transmitir(EnvioArquivo *e, int sock, size_t max) {
+    if (e->usar_splice) return transmitir_splice(e, sock, max);
+
+    size_t total = 0;
+    while (total < max && e->offset < e->fim) {
+        size_t pedir = minimo(max - total, (size_t)(e->fim - e->offset));
+        ssize_t n = sendfile(sock, e->fd, &e->offset, pedir);
+        if (n > 0) {
+            total += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EINVAL || errno == ENOSYS) && total == 0) {
+            // Origem ou destino sem suporte a sendfile: cai para splice via pipe
+            if (pipe2(e->pipe_fd, O_CLOEXEC) < 0) return -1;
+            e->usar_splice = 1;
+            return transmitir_splice(e, sock, max);
+        }
+        if (n == 0) errno = EIO; // arquivo encolheu durante o envio
+        return total > 0 ? (ssize_t)total : -1;
+    }
+    return total;
+}
+
+size_t envio_fatia_bytes(double taxa_kBps) {
+    size_t fatia = (size_t)(taxa_kBps * 1024.0 * FATIA_MS / 1000.0);
+    return fatia < 4096 ? 4096 : fatia;
+}
+
+static void avancar_relogio(struct timespec *t, double segundos) {
+    long ns = (long)(segundos * 1e9);
+    t->tv_sec += ns / 1000000000L;
+    t->tv_nsec += ns % 1000000000L;
+    if (t->tv_nsec >= 1000000000L) {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000L;
+    }
+}
+
+int enviar_arquivo_ritmado(int sock, int fd, off_t tamanho, double taxa_kBps) {
+    EnvioArquivo e;
+    envio_iniciar(&e, fd, 0, tamanho);
+
+    // Prazo absoluto de cada fatia: o tempo gasto no envio já conta para a taxa
+    struct timespec prazo;
+    clock_gettime(CLOCK_MONOTONIC, &prazo);
+
+    int ret = 0;
+    while (!envio_concluido(&e)) {
+        size_t fatia = (taxa_kBps > 0) ? envio_fatia_bytes(taxa_kBps) : SIZE_MAX;
+        size_t enviados = 0;
+        while (enviados < fatia && !envio_concluido(&e)) {
+            ssize_t n = envio_transmitir(&e, sock, fatia - enviados);
+            if (n > 0) {
+                enviados += n;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                struct pollfd p = { .fd = sock, .events = POLLOUT };
+                poll(&p, 1, -1);
+            } else {
+                ret = -1;
+                goto fim;
+            }
+        }
+        if (taxa_kBps > 0) {
+            avancar_relogio(&prazo, enviados / (taxa_kBps * 1024.0));
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &prazo, NULL) == EINTR);
+        }
+    }
+
+fim:
+    envio_liberar(&e);
+    return ret;
+}
@@ -0,0 +1,41 @@
+// envio.h
+// Transmissão de arquivos sem cópia para o espaço do usuário (sendfile, com splice como reserva)
+
+#ifndef ENVIO_H
+#define ENVIO_H
+
+#include <sys/types.h>
+
+#define FATIA_MS 50 // duração de cada fatia de envio ritmado
+#define CAPACIDADE_PIPE 65536 // capacidade padrão de um pipe no Linux
+
+// Estado de um envio em andamento; serve para sockets bloqueantes e não bloqueantes
+typedef struct {
+    int fd;           // arquivo de origem
+    off_t offset;     // próximo byte a ler do arquivo
+    off_t fim;        // um byte depois do último a enviar
+    int usar_splice;  // 1 quando sendfile não é suportado para este par de descritores
+    int pipe_fd[2];   // pipe intermediário do splice
+    size_t no_pipe;   // bytes já lidos do arquivo e ainda no pipe
+} EnvioArquivo;
+
+void envio_iniciar(EnvioArquivo *e, int fd, off_t inicio, off_t fim);
+// Envia até 'max' bytes. Retorna os bytes aceitos pelo socket, 0 se não há mais nada a enviar
+// ou -1 com errno (EAGAIN quando o socket não bloqueante está cheio)
+ssize_t envio_transmitir(EnvioArquivo *e, int sock, size_t max);
+int envio_concluido(const EnvioArquivo *e);
+off_t envio_restante(const EnvioArquivo *e);
+void envio_liberar(EnvioArquivo *e);
+// Cria o pipe do splice de antemão (para quem transmite por conta própria, como o motor io_uring)
+int envio_preparar_pipe(EnvioArquivo *e);
+// Conta 'n' bytes do trecho enviados por fora (copiados do mapeamento junto com o cabeçalho)
+void envio_avancar(EnvioArquivo *e, size_t n);
+// Passa para outro trecho do mesmo arquivo mantendo o pipe do splice (o trecho atual deve ter terminado)
+void envio_reposicionar(EnvioArquivo *e, off_t inicio, off_t fim);
+
+// Bytes de uma fatia de FATIA_MS na taxa dada (nunca menos que um bloco de 4 KB)
+size_t envio_fatia_bytes(double taxa_kBps);
+// Envia [0, tamanho) do arquivo em fatias na taxa dada (0 = sem limite). Retorna 0 ou -1
+int enviar_arquivo_ritmado(int sock, int fd, off_t tamanho, double taxa_kBps);
+
+#endif
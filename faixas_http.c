@@ -0,0 +1,122 @@
+// faixas_http.c
+// Requisições parciais (Range: bytes=...) e partes de multipart/byteranges
+
+#include "faixas_http.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define FAIXAS_LIDAS_MAX 64 // faixas aceitas no cabeçalho antes de unir as sobrepostas
+
+static int ler_numero(const char *v, size_t len, size_t *i, off_t *num) {
+    size_t ini = *i;
+    off_t n = 0;
+    while (*i < len && v[*i] >= '0' && v[*i] <= '9') {
+        if (n > (INT64_MAX - 9) / 10) return 0; // não cabe em off_t
+        n = n * 10 + (v[*i] - '0');
+        (*i)++;
+    }
+    *num = n;
+    return *i > ini;
+}
+
+static void pular_espacos(const char *v, size_t len, size_t *i) {
+    while (*i < len && (v[*i] == ' ' || v[*i] == '\t')) (*i)++;
+}
+
+static int comparar_faixas(const void *a, const void *b) {
+    off_t x = ((const Faixa *)a)->inicio, y = ((const Faixa *)b)->inicio;
+    return (x > y) - (x < y);
+}
+
+ResultadoFaixas faixas_ler(const char *valor, size_t len, off_t tamanho, RespostaFaixas *r) {
+    Faixa lidas[FAIXAS_LIDAS_MAX];
+    int n = 0, validas = 0;
+    size_t i = 0;
+
+    r->n = 0;
+    r->partes = NULL;
+    pular_espacos(valor, len, &i);
+    if (len - i < 6 || strncasecmp(valor + i, "bytes=", 6) != 0) return FAIXAS_IGNORAR;
+    i += 6;
+
+    while (i < len) {
+        pular_espacos(valor, len, &i);
+        if (i < len && valor[i] == ',') { // elementos vazios da lista são permitidos
+            i++;
+            continue;
+        }
+        if (i == len) break;
+
+        off_t primeiro, ultimo;
+        Faixa f;
+        if (valor[i] == '-') { // sufixo: os últimos N bytes
+            i++;
+            if (!ler_numero(valor, len, &i, &ultimo)) return FAIXAS_IGNORAR;
+            f.inicio = ultimo >= tamanho ? 0 : tamanho - ultimo;
+            f.fim = ultimo > 0 ? tamanho : f.inicio;
+        } else {
+            if (!ler_numero(valor, len, &i, &primeiro) || i == len || valor[i] != '-')
+                return FAIXAS_IGNORAR;
+            i++;
+            if (ler_numero(valor, len, &i, &ultimo)) {
+                if (ultimo < primeiro) return FAIXAS_IGNORAR;
+                f.fim = ultimo >= tamanho ? tamanho : ultimo + 1;
+            } else {
+                f.fim = tamanho;
+            }
+            f.inicio = primeiro;
+        }
+        pular_espacos(valor, len, &i);
+        if (i < len && valor[i] != ',') return FAIXAS_IGNORAR;
+
+        if (n == FAIXAS_LIDAS_MAX) return FAIXAS_IGNORAR;
+        if (f.inicio < f.fim) { // as que começam depois do fim são descartadas
+            lidas[n++] = f;
+            validas++;
+        }
+    }
+    if (validas == 0) return FAIXAS_INSATISFAZIVEL;
+
+    // Ordena e une as sobrepostas ou adjacentes: um cliente não multiplica o arquivo pedindo a mesma faixa várias vezes
+    qsort(lidas, n, sizeof(Faixa), comparar_faixas);
+    for (int k = 0; k < n; k++) {
+        if (r->n > 0 && lidas[k].inicio <= r->faixa[r->n - 1].fim) {
+            if (lidas[k].fim > r->faixa[r->n - 1].fim) r->faixa[r->n - 1].fim = lidas[k].fim;
+            continue;
+        }
+        if (r->n == FAIXAS_MAX) {
+            r->n = 0;
+            return FAIXAS_IGNORAR;
+        }
+        r->faixa[r->n++] = lidas[k];
+    }
+    return FAIXAS_OK;
+}
+
+size_t faixas_partes_cap(const RespostaFaixas *r, const char *tipo, const char *separador) {
+    return (size_t)(r->n + 1) * (strlen(tipo) + strlen(separador) + 96);
+}
+
+off_t faixas_montar_partes(RespostaFaixas *r, char *buf, size_t cap, const char *tipo, const char *separador,
+                           off_t tamanho) {
+    r->partes = buf;
+    r->partes_cap = cap;
+
+    size_t pos = 0;
+    off_t total = 0;
+    for (int k = 0; k < r->n; k++) {
+        r->parte_ini[k] = (uint32_t)pos;
+        pos += snprintf(r->partes + pos, cap - pos,
+                        "%s--%s\r\nContent-Type: %s\r\nContent-Range: bytes %lld-%lld/%lld\r\n\r\n",
+                        k == 0 ? "" : "\r\n", separador, tipo, (long long)r->faixa[k].inicio,
+                        (long long)r->faixa[k].fim - 1, (long long)tamanho);
+        total += r->faixa[k].fim - r->faixa[k].inicio;
+    }
+    r->parte_ini[r->n] = (uint32_t)pos;
+    pos += snprintf(r->partes + pos, cap - pos, "\r\n--%s--\r\n", separador);
+    r->parte_ini[r->n + 1] = (uint32_t)pos;
+    return total + (off_t)pos;
+}
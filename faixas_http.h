@@ -0,0 +1,42 @@
+// faixas_http.h
+// Requisições parciais (Range: bytes=...): interpretação das faixas pedidas e montagem
+// das partes de multipart/byteranges. O corpo de cada faixa continua saindo do arquivo
+// pelo envio sem cópia; só os cabeçalhos das partes ficam em memória
+
+#ifndef FAIXAS_HTTP_H
+#define FAIXAS_HTTP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define FAIXAS_MAX 16 // mais faixas que isso (depois de unir as sobrepostas): envia o arquivo inteiro
+
+typedef struct {
+    off_t inicio, fim; // [inicio, fim)
+} Faixa;
+
+typedef enum {
+    FAIXAS_IGNORAR,       // sem Range válido: resposta 200 com o arquivo inteiro
+    FAIXAS_OK,            // 206 com as faixas em ordem crescente, sem sobreposição
+    FAIXAS_INSATISFAZIVEL // nenhuma faixa cabe no arquivo: 416
+} ResultadoFaixas;
+
+typedef struct {
+    Faixa faixa[FAIXAS_MAX];
+    int n;
+    char *partes;                       // cabeçalhos das partes e o delimitador final (multipart)
+    size_t partes_cap;                  // tamanho do buffer de 'partes' (de quem o forneceu)
+    uint32_t parte_ini[FAIXAS_MAX + 2]; // parte i em [parte_ini[i], parte_ini[i + 1]); a parte n fecha o corpo
+} RespostaFaixas;
+
+// Interpreta o valor do cabeçalho Range para um arquivo de 'tamanho' bytes
+ResultadoFaixas faixas_ler(const char *valor, size_t len, off_t tamanho, RespostaFaixas *r);
+// Bytes que os cabeçalhos das partes e o delimitador final podem ocupar
+size_t faixas_partes_cap(const RespostaFaixas *r, const char *tipo, const char *separador);
+// Monta as partes de multipart/byteranges em 'buf' (com faixas_partes_cap bytes), que passa a
+// ser r->partes. Retorna o tamanho total do corpo
+off_t faixas_montar_partes(RespostaFaixas *r, char *buf, size_t cap, const char *tipo, const char *separador,
+                           off_t tamanho);
+
+#endif
@@ -0,0 +1,118 @@
+// fila_admissao.c
+// Fila de admissão com enfileiramento justo ponderado
+
+#include "fila_admissao.h"
+
+#include <stdlib.h>
+
+int fila_iniciar(FilaAdmissao *f, OrcamentoBanda *o, size_t capacidade, ConcederAdmissao conceder) {
+    pthread_mutex_init(&f->trava, NULL);
+    f->heap = calloc(capacidade ? capacidade : 1, sizeof(EsperaAdmissao *));
+    if (!f->heap) return -1;
+    f->capacidade = capacidade;
+    atomic_init(&f->num, 0);
+    f->virtual = 0;
+    f->orcamento = o;
+    f->conceder = conceder;
+    return 0;
+}
+
+static int antes(const EsperaAdmissao *a, const EsperaAdmissao *b) {
+    return a->termino < b->termino;
+}
+
+static void colocar(FilaAdmissao *f, size_t i, EsperaAdmissao *e) {
+    f->heap[i] = e;
+    e->pos = (int)i;
+}
+
+static void subir(FilaAdmissao *f, size_t i) {
+    EsperaAdmissao *e = f->heap[i];
+    while (i > 0 && antes(e, f->heap[(i - 1) / 2])) {
+        colocar(f, i, f->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    colocar(f, i, e);
+}
+
+static void descer(FilaAdmissao *f, size_t i, size_t n) {
+    EsperaAdmissao *e = f->heap[i];
+    while (2 * i + 1 < n) {
+        size_t filho = 2 * i + 1;
+        if (filho + 1 < n && antes(f->heap[filho + 1], f->heap[filho])) filho++;
+        if (!antes(f->heap[filho], e)) break;
+        colocar(f, i, f->heap[filho]);
+        i = filho;
+    }
+    colocar(f, i, e);
+}
+
+static void remover(FilaAdmissao *f, EsperaAdmissao *e) {
+    size_t n = atomic_load_explicit(&f->num, memory_order_relaxed) - 1;
+    size_t i = (size_t)e->pos;
+    e->pos = -1;
+    atomic_store_explicit(&f->num, n, memory_order_relaxed);
+    if (i == n) return;
+    colocar(f, i, f->heap[n]);
+    subir(f, i);
+    descer(f, (size_t)f->heap[i]->pos, n);
+}
+
+static void despachar_travado(FilaAdmissao *f) {
+    // Em ordem de término: a primeira que não cabe segura as seguintes (sem ultrapassagem)
+    while (atomic_load_explicit(&f->num, memory_order_relaxed) > 0) {
+        EsperaAdmissao *e = f->heap[0];
+        if (!orcamento_reservar(f->orcamento, e->reserva_Bps)) break;
+        f->virtual = e->termino;
+        remover(f, e);
+        f->conceder(e);
+    }
+}
+
+int fila_entrar(FilaAdmissao *f, EsperaAdmissao *e, uint32_t fluxo, double peso, int64_t reserva_Bps) {
+    pthread_mutex_lock(&f->trava);
+    size_t n = atomic_load_explicit(&f->num, memory_order_relaxed);
+    if (n >= f->capacidade) {
+        pthread_mutex_unlock(&f->trava);
+        return 0;
+    }
+    // Início = maior entre o tempo virtual e o término da última espera do mesmo fluxo
+    double inicio = f->virtual;
+    for (size_t i = 0; i < n; i++)
+        if (f->heap[i]->fluxo == fluxo && f->heap[i]->termino > inicio) inicio = f->heap[i]->termino;
+    e->termino = inicio + 1.0 / (peso > 0 ? peso : 1);
+    e->fluxo = fluxo;
+    e->reserva_Bps = reserva_Bps;
+    atomic_store_explicit(&f->num, n + 1, memory_order_relaxed);
+    colocar(f, n, e);
+    subir(f, n);
+    // A banda pode ter sido liberada entre a recusa e a entrada na fila. A barreira pareia com a
+    // de fila_despachar: ou quem libera vê a fila não vazia, ou aqui se vê a banda liberada
+    atomic_thread_fence(memory_order_seq_cst);
+    despachar_travado(f);
+    pthread_mutex_unlock(&f->trava);
+    return 1;
+}
+
+int fila_sair(FilaAdmissao *f, EsperaAdmissao *e) {
+    pthread_mutex_lock(&f->trava);
+    int esperava = (e->pos >= 0);
+    if (esperava) {
+        remover(f, e);
+        despachar_travado(f); // a cabeça pode ter mudado para uma reserva que cabe
+    }
+    pthread_mutex_unlock(&f->trava);
+    return esperava;
+}
+
+void fila_despachar(FilaAdmissao *f) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&f->num, memory_order_relaxed) == 0) return;
+    pthread_mutex_lock(&f->trava);
+    despachar_travado(f);
+    pthread_mutex_unlock(&f->trava);
+}
+
+size_t fila_tamanho(FilaAdmissao *f) {
+    return atomic_load_explicit(&f->num, memory_order_relaxed);
+}
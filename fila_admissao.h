@@ -0,0 +1,48 @@
+// fila_admissao.h
+// Fila de admissão com enfileiramento justo ponderado (WFQ auto-cronometrado):
+// requisições que não cabem no orçamento de banda esperam aqui em vez de receber 503.
+// Cada cliente é um fluxo com peso igual à sua taxa de QoS; a cada banda liberada, a
+// requisição com menor tempo virtual de término é atendida se a sua reserva couber
+
+#ifndef FILA_ADMISSAO_H
+#define FILA_ADMISSAO_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "orcamento_banda.h"
+
+// Nó intrusivo: fica dentro da estrutura de quem espera (ver container_of em roda_timers.h)
+typedef struct EsperaAdmissao {
+    double termino;         // tempo virtual de término (ordem de atendimento)
+    uint32_t fluxo;         // identifica o cliente
+    int64_t reserva_Bps;
+    int pos;                // posição no heap; -1 fora da fila
+    struct EsperaAdmissao *prox; // uso livre de quem recebe a concessão
+} EsperaAdmissao;
+
+// Chamado com a trava da fila quando a reserva de 'e' já foi feita no orçamento
+typedef void (*ConcederAdmissao)(EsperaAdmissao *e);
+
+typedef struct {
+    pthread_mutex_t trava;
+    EsperaAdmissao **heap;
+    size_t capacidade;
+    _Atomic size_t num;     // lido sem trava no caminho rápido
+    double virtual;         // término da última requisição atendida
+    OrcamentoBanda *orcamento;
+    ConcederAdmissao conceder;
+} FilaAdmissao;
+
+int fila_iniciar(FilaAdmissao *f, OrcamentoBanda *o, size_t capacidade, ConcederAdmissao conceder);
+// Enfileira com o peso dado. Retorna 1 se entrou (pode ser concedida na hora), 0 se a fila está cheia
+int fila_entrar(FilaAdmissao *f, EsperaAdmissao *e, uint32_t fluxo, double peso, int64_t reserva_Bps);
+// Retira da fila. Retorna 1 se ainda esperava, 0 se já foi concedida
+int fila_sair(FilaAdmissao *f, EsperaAdmissao *e);
+// Concede às primeiras da fila enquanto as reservas couberem; chamar após liberar banda
+void fila_despachar(FilaAdmissao *f);
+size_t fila_tamanho(FilaAdmissao *f);
+
+#endif
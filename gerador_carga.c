@@ -0,0 +1,681 @@
+// gerador_carga.c
+// Gerador de carga para o servidor: cada thread tem seu epoll e muitas conexões não bloqueantes.
+// Mede vazão, latência (p50/p99/p999), taxa de 503 e a banda obtida por IP de origem (comparada
+// com a taxa do arquivo de QoS) e confere os bytes recebidos com os arquivos de origem
+// Compilação: gcc -O2 gerador_carga.c qos.c -o gerador_carga -lpthread
+// Ex: ./gerador_carga -c 50 -d 10 -p /gato.jpg=gato.jpg -i 127.0.0.1 -i 127.0.0.2 -q qos_config.txt -o resultado.json localhost 5000
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "qos.h"
+
+#define MAX_ALVOS 64
+#define MAX_ORIGENS 64
+#define MAX_EVENTOS 256
+#define BUF_CABECALHO 8192
+#define BUF_LEITURA 65536
+#define TX_PADRAO 1000 // kB/s dos IPs sem regra (o mesmo padrão do servidor)
+
+// Histograma log-linear em µs: valores < 128 exatos; acima, 64 sub-baldes por potência de 2
+#define SUB_BALDES 64
+#define MAX_EXPOENTE 34
+#define NUM_BALDES (SUB_BALDES * (MAX_EXPOENTE + 1) + SUB_BALDES)
+
+typedef struct {
+    uint64_t baldes[NUM_BALDES];
+    uint64_t contagem, soma, maximo;
+} Histograma;
+
+typedef struct {
+    const char *caminho;   // alvo da requisição
+    const char *arquivo;   // arquivo de referência (NULL: não confere)
+    const char *corpo;     // conteúdo mapeado
+    size_t tamanho;
+} Alvo;
+
+typedef struct {
+    char texto[INET_ADDRSTRLEN];
+    struct in_addr addr;
+    double taxa_kBps;      // taxa configurada no QoS (0 sem -q)
+} Origem;
+
+typedef struct {
+    uint64_t requisicoes, bytes, tempo_transf_us;
+} EstatOrigem;
+
+typedef struct {
+    uint64_t iniciadas, concluidas, recusas, erros, divergencias, interrompidas;
+    uint64_t status[6];    // por classe: 1xx..5xx (0 = sem resposta válida)
+    uint64_t bytes;
+    Histograma latencia, ttfb;
+    EstatOrigem origem[MAX_ORIGENS];
+} Estatisticas;
+
+typedef enum {
+    C_LIVRE,       // sem requisição em andamento (socket aberto ou não)
+    C_CONECTANDO,
+    C_ENVIANDO,
+    C_CABECALHO,
+    C_CORPO
+} EstadoConexao;
+
+typedef struct {
+    int fd;
+    int origem;
+    int alvo;
+    EstadoConexao estado;
+    int feitas;            // requisições já enviadas nesta conexão
+    int fechar;            // a resposta atual encerra a conexão
+    char req[512];
+    size_t req_len, req_enviado;
+    char cab[BUF_CABECALHO];
+    size_t cab_len;
+    int status;
+    int64_t corpo_total, corpo_recebido;
+    int diverge;
+    uint64_t inicio_us, primeiro_byte_us;
+} Conexao;
+
+typedef struct {
+    pthread_t thread;
+    int epfd;
+    Conexao *conexoes;
+    int num_conexoes;
+    int *livres;           // pilha de conexões sem requisição
+    int num_livres;
+    uint64_t *pendentes;   // instantes planejados ainda sem conexão livre (modo taxa fixa)
+    size_t pend_ini, pend_len, pend_cap;
+    double taxa;           // requisições por segundo desta thread (0 = o mais rápido possível)
+    uint64_t proxima_us;
+    unsigned semente;
+    Estatisticas est;
+} Trabalhador;
+
+// Configuração
+static struct sockaddr_in destino;
+static char host[256] = "localhost";
+static Alvo alvos[MAX_ALVOS];
+static int num_alvos;
+static Origem origens[MAX_ORIGENS];
+static int num_origens;
+static int num_conexoes = 10, num_threads = 1, req_por_conexao = 100;
+static double duracao_s = 10, taxa_total = 0;
+static int64_t total_requisicoes = 0; // 0 = limitado pela duração
+static const char *saida_json = NULL;
+
+static atomic_int_fast64_t restantes;
+static uint64_t fim_us;
+
+static uint64_t agora_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int indice_balde(uint64_t v) {
+    if (v < 2 * SUB_BALDES) return (int)v;
+    int e = 63 - __builtin_clzll(v) - 6;
+    if (e > MAX_EXPOENTE) return NUM_BALDES - 1;
+    return SUB_BALDES * e + (int)(v >> e);
+}
+
+static uint64_t valor_balde(int i) {
+    if (i < 2 * SUB_BALDES) return (uint64_t)i;
+    int e = i / SUB_BALDES - 1;
+    uint64_t m = (uint64_t)(i % SUB_BALDES + SUB_BALDES);
+    return ((m + 1) << e) - 1;
+}
+
+static void hist_registrar(Histograma *h, uint64_t v) {
+    h->baldes[indice_balde(v)]++;
+    h->contagem++;
+    h->soma += v;
+    if (v > h->maximo) h->maximo = v;
+}
+
+static void hist_somar(Histograma *d, const Histograma *o) {
+    for (int i = 0; i < NUM_BALDES; i++) d->baldes[i] += o->baldes[i];
+    d->contagem += o->contagem;
+    d->soma += o->soma;
+    if (o->maximo > d->maximo) d->maximo = o->maximo;
+}
+
+static uint64_t hist_quantil(const Histograma *h, double q) {
+    if (h->contagem == 0) return 0;
+    uint64_t alvo = (uint64_t)(q * h->contagem + 0.5), acumulado = 0;
+    if (alvo == 0) alvo = 1;
+    for (int i = 0; i < NUM_BALDES; i++) {
+        acumulado += h->baldes[i];
+        if (acumulado >= alvo) return valor_balde(i) < h->maximo ? valor_balde(i) : h->maximo;
+    }
+    return h->maximo;
+}
+
+// ---- Conexões ----
+
+static void fechar_socket(Trabalhador *t, Conexao *c) {
+    if (c->fd >= 0) {
+        epoll_ctl(t->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+    }
+    c->fd = -1;
+    c->feitas = 0;
+}
+
+static void liberar(Trabalhador *t, Conexao *c) {
+    c->estado = C_LIVRE;
+    t->livres[t->num_livres++] = (int)(c - t->conexoes);
+}
+
+static void falhar(Trabalhador *t, Conexao *c) {
+    t->est.erros++;
+    t->est.status[0]++;
+    fechar_socket(t, c);
+    liberar(t, c);
+}
+
+static int abrir_socket(Trabalhador *t, Conexao *c) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (num_origens > 0) {
+        // Origem fixa por conexão: exercita as regras de QoS de cada IP
+        struct sockaddr_in local = { .sin_family = AF_INET, .sin_addr = origens[c->origem].addr };
+        if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (connect(fd, (struct sockaddr *)&destino, sizeof(destino)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = c };
+    if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close(fd);
+        return -1;
+    }
+    c->fd = fd;
+    return 0;
+}
+
+static void enviar(Trabalhador *t, Conexao *c);
+
+// Começa uma requisição na conexão livre; 'inicio' é o instante planejado (base da latência)
+static void iniciar_requisicao(Trabalhador *t, Conexao *c, uint64_t inicio) {
+    c->alvo = num_alvos > 1 ? (int)(rand_r(&t->semente) % num_alvos) : 0;
+    c->feitas++;
+    c->fechar = c->feitas >= req_por_conexao;
+    c->req_len = snprintf(c->req, sizeof(c->req), "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n",
+                          alvos[c->alvo].caminho, host, c->fechar ? "close" : "keep-alive");
+    c->req_enviado = 0;
+    c->cab_len = 0;
+    c->status = 0;
+    c->corpo_total = -1;
+    c->corpo_recebido = 0;
+    c->diverge = 0;
+    c->inicio_us = inicio;
+    c->primeiro_byte_us = 0;
+    t->est.iniciadas++;
+
+    if (c->fd < 0) {
+        if (abrir_socket(t, c) < 0) {
+            falhar(t, c);
+            return;
+        }
+        c->estado = C_CONECTANDO;
+        return; // EPOLLOUT avisa quando conectar
+    }
+    c->estado = C_ENVIANDO;
+    enviar(t, c);
+}
+
+static void concluir(Trabalhador *t, Conexao *c) {
+    uint64_t agora = agora_us();
+    Estatisticas *e = &t->est;
+    e->concluidas++;
+    e->status[c->status / 100 < 6 ? c->status / 100 : 0]++;
+    if (c->status == 503) e->recusas++;
+    e->bytes += (uint64_t)c->corpo_recebido;
+    hist_registrar(&e->latencia, agora - c->inicio_us);
+    hist_registrar(&e->ttfb, c->primeiro_byte_us - c->inicio_us);
+
+    const Alvo *a = &alvos[c->alvo];
+    if (c->status == 200) {
+        if (a->arquivo && (c->diverge || (size_t)c->corpo_recebido != a->tamanho)) e->divergencias++;
+        EstatOrigem *o = &e->origem[c->origem];
+        o->requisicoes++;
+        o->bytes += (uint64_t)c->corpo_recebido;
+        o->tempo_transf_us += agora - c->primeiro_byte_us;
+    }
+
+    if (c->fechar) fechar_socket(t, c);
+    liberar(t, c);
+}
+
+static void enviar(Trabalhador *t, Conexao *c) {
+    while (c->req_enviado < c->req_len) {
+        ssize_t n = send(c->fd, c->req + c->req_enviado, c->req_len - c->req_enviado, MSG_NOSIGNAL);
+        if (n > 0) {
+            c->req_enviado += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        falhar(t, c);
+        return;
+    }
+    c->estado = C_CABECALHO;
+}
+
+// Confere o trecho do corpo com o arquivo de referência (só em 200)
+static void receber_corpo(Conexao *c, const char *dados, size_t n) {
+    const Alvo *a = &alvos[c->alvo];
+    if (c->status == 200 && a->arquivo && !c->diverge) {
+        if ((size_t)c->corpo_recebido + n > a->tamanho ||
+            memcmp(a->corpo + c->corpo_recebido, dados, n) != 0)
+            c->diverge = 1;
+    }
+    c->corpo_recebido += n;
+}
+
+// Interpreta status, Content-Length e Connection. Retorna o tamanho do cabeçalho ou 0 se incompleto
+static size_t ler_cabecalho(Conexao *c) {
+    char *fim = memmem(c->cab, c->cab_len, "\r\n\r\n", 4);
+    if (!fim) return 0;
+    size_t tam = (size_t)(fim - c->cab) + 4;
+    *fim = '\0';
+    if (sscanf(c->cab, "HTTP/1.%*d %d", &c->status) != 1) c->status = 0;
+    for (char *linha = strstr(c->cab, "\r\n"); linha; linha = strstr(linha, "\r\n")) {
+        linha += 2;
+        char *fim_linha = strstr(linha, "\r\n");
+        size_t len = fim_linha ? (size_t)(fim_linha - linha) : strlen(linha);
+        if (strncasecmp(linha, "Content-Length:", 15) == 0)
+            c->corpo_total = strtoll(linha + 15, NULL, 10);
+        else if (strncasecmp(linha, "Connection:", 11) == 0 && memmem(linha, len, "close", 5))
+            c->fechar = 1;
+    }
+    return tam;
+}
+
+static void ler(Trabalhador *t, Conexao *c) {
+    static __thread char buf[BUF_LEITURA];
+    while (c->estado == C_CABECALHO || c->estado == C_CORPO) {
+        ssize_t n;
+        if (c->estado == C_CABECALHO) {
+            n = read(c->fd, c->cab + c->cab_len, sizeof(c->cab) - 1 - c->cab_len);
+        } else {
+            int64_t falta = c->corpo_total - c->corpo_recebido;
+            n = read(c->fd, buf, falta < (int64_t)sizeof(buf) ? (size_t)falta : sizeof(buf));
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) { // erro ou servidor fechou antes do fim da resposta
+            falhar(t, c);
+            return;
+        }
+        if (c->primeiro_byte_us == 0) c->primeiro_byte_us = agora_us();
+
+        if (c->estado == C_CORPO) {
+            receber_corpo(c, buf, (size_t)n);
+        } else {
+            c->cab_len += n;
+            c->cab[c->cab_len] = '\0';
+            size_t tam = ler_cabecalho(c);
+            if (tam == 0) {
+                if (c->cab_len == sizeof(c->cab) - 1) {
+                    falhar(t, c);
+                    return;
+                }
+                continue;
+            }
+            if (c->corpo_total < 0) { // sem Content-Length o fim do corpo seria ambíguo
+                falhar(t, c);
+                return;
+            }
+            c->estado = C_CORPO;
+            size_t sobra = c->cab_len - tam;
+            if ((int64_t)sobra > c->corpo_total) sobra = (size_t)c->corpo_total;
+            receber_corpo(c, c->cab + tam, sobra);
+        }
+        if (c->estado == C_CORPO && c->corpo_recebido >= c->corpo_total) {
+            concluir(t, c);
+            return;
+        }
+    }
+}
+
+static void tratar_evento(Trabalhador *t, Conexao *c, uint32_t eventos) {
+    if (c->estado == C_LIVRE) { // servidor fechou a conexão ociosa: a próxima requisição reconecta
+        if (eventos & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) fechar_socket(t, c);
+        return;
+    }
+    if (c->estado == C_CONECTANDO) {
+        if (!(eventos & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return;
+        int erro = 0;
+        socklen_t len = sizeof(erro);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &erro, &len);
+        if (erro) {
+            falhar(t, c);
+            return;
+        }
+        c->estado = C_ENVIANDO;
+    }
+    if (c->estado == C_ENVIANDO) enviar(t, c);
+    if (c->estado == C_CABECALHO || c->estado == C_CORPO) ler(t, c);
+    else if (c->estado == C_ENVIANDO && (eventos & (EPOLLERR | EPOLLHUP))) falhar(t, c);
+}
+
+// Reserva uma requisição do total (-n); sem limite de quantidade, só o prazo vale
+static int pegar_requisicao(void) {
+    if (total_requisicoes == 0) return 1;
+    return atomic_fetch_sub(&restantes, 1) > 0;
+}
+
+static void *trabalhar(void *arg) {
+    Trabalhador *t = arg;
+    struct epoll_event eventos[MAX_EVENTOS];
+    int acabou = 0; // sem mais requisições a iniciar
+    t->proxima_us = agora_us();
+
+    while (1) {
+        uint64_t agora = agora_us();
+        if (total_requisicoes == 0 && agora >= fim_us) break;
+
+        if (!acabou) {
+            if (t->taxa > 0) {
+                // Taxa fixa (laço aberto): os instantes planejados não esperam o servidor; sem
+                // conexão livre, ficam pendentes e a espera entra na latência
+                while (t->proxima_us <= agora && !acabou) {
+                    if (!pegar_requisicao()) {
+                        acabou = 1;
+                        break;
+                    }
+                    if (t->pend_len == t->pend_cap) { // fila cheia: o servidor não acompanha
+                        t->est.interrompidas++;
+                    } else {
+                        t->pendentes[(t->pend_ini + t->pend_len++) % t->pend_cap] = t->proxima_us;
+                    }
+                    t->proxima_us += (uint64_t)(1e6 / t->taxa);
+                }
+                while (t->pend_len > 0 && t->num_livres > 0) {
+                    uint64_t inicio = t->pendentes[t->pend_ini];
+                    t->pend_ini = (t->pend_ini + 1) % t->pend_cap;
+                    t->pend_len--;
+                    iniciar_requisicao(t, &t->conexoes[t->livres[--t->num_livres]], inicio);
+                }
+            } else {
+                while (t->num_livres > 0) {
+                    if (!pegar_requisicao()) {
+                        acabou = 1;
+                        break;
+                    }
+                    iniciar_requisicao(t, &t->conexoes[t->livres[--t->num_livres]], agora);
+                }
+            }
+        }
+        if (acabou && t->num_livres == t->num_conexoes && t->pend_len == 0) break;
+
+        int espera = 100;
+        if (t->taxa > 0 && !acabou) {
+            int64_t ate = ((int64_t)t->proxima_us - (int64_t)agora_us()) / 1000;
+            espera = ate < 0 ? 0 : ate < espera ? (int)ate : espera;
+        }
+        int n = epoll_wait(t->epfd, eventos, MAX_EVENTOS, espera);
+        for (int i = 0; i < n; i++)
+            tratar_evento(t, eventos[i].data.ptr, eventos[i].events);
+    }
+
+    // Prazo esgotado: o que está em andamento não entra nas medidas
+    for (int i = 0; i < t->num_conexoes; i++) {
+        if (t->conexoes[i].estado != C_LIVRE) t->est.interrompidas++;
+        fechar_socket(t, &t->conexoes[i]);
+    }
+    return NULL;
+}
+
+// ---- Configuração e relatório ----
+
+static void adicionar_alvo(char *espec) {
+    if (num_alvos == MAX_ALVOS) {
+        fprintf(stderr, "Máximo de %d caminhos\n", MAX_ALVOS);
+        exit(EXIT_FAILURE);
+    }
+    Alvo *a = &alvos[num_alvos++];
+    char *igual = strchr(espec, '=');
+    a->caminho = espec;
+    if (!igual) return;
+    *igual = '\0';
+    a->arquivo = igual + 1;
+    int fd = open(a->arquivo, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(a->arquivo);
+        exit(EXIT_FAILURE);
+    }
+    a->tamanho = st.st_size;
+    a->corpo = "";
+    if (a->tamanho > 0) {
+        a->corpo = mmap(NULL, a->tamanho, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (a->corpo == MAP_FAILED) {
+            perror("mmap");
+            exit(EXIT_FAILURE);
+        }
+    }
+    close(fd);
+}
+
+static void adicionar_origem(const char *ip) {
+    if (num_origens == MAX_ORIGENS) {
+        fprintf(stderr, "Máximo de %d IPs de origem\n", MAX_ORIGENS);
+        exit(EXIT_FAILURE);
+    }
+    Origem *o = &origens[num_origens];
+    if (inet_pton(AF_INET, ip, &o->addr) != 1) {
+        fprintf(stderr, "IP de origem inválido: %s\n", ip);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(o->texto, sizeof(o->texto), "%s", ip);
+    num_origens++;
+}
+
+static void resolver_destino(const char *nome, const char *porta) {
+    struct addrinfo dicas = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *res;
+    int erro = getaddrinfo(nome, porta, &dicas, &res);
+    if (erro != 0) {
+        fprintf(stderr, "%s: %s\n", nome, gai_strerror(erro));
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&destino, res->ai_addr, sizeof(destino));
+    freeaddrinfo(res);
+    snprintf(host, sizeof(host), "%s", nome);
+}
+
+static void escrever_json(FILE *f, const Estatisticas *e, double duracao) {
+    fprintf(f, "{\n  \"conexoes\": %d, \"threads\": %d, \"req_por_conexao\": %d, \"taxa_alvo_req_s\": %.1f,\n",
+            num_conexoes, num_threads, req_por_conexao, taxa_total);
+    fprintf(f, "  \"duracao_s\": %.3f, \"concluidas\": %llu, \"erros\": %llu, \"interrompidas\": %llu,\n",
+            duracao, (unsigned long long)e->concluidas, (unsigned long long)e->erros,
+            (unsigned long long)e->interrompidas);
+    fprintf(f, "  \"status\": {\"2xx\": %llu, \"3xx\": %llu, \"4xx\": %llu, \"5xx\": %llu},\n",
+            (unsigned long long)e->status[2], (unsigned long long)e->status[3],
+            (unsigned long long)e->status[4], (unsigned long long)e->status[5]);
+    fprintf(f, "  \"taxa_503\": %.6f, \"divergencias\": %llu,\n",
+            e->concluidas ? (double)e->recusas / e->concluidas : 0.0, (unsigned long long)e->divergencias);
+    fprintf(f, "  \"vazao_req_s\": %.2f, \"vazao_kBps\": %.2f,\n", e->concluidas / duracao,
+            e->bytes / 1024.0 / duracao);
+    const Histograma *hs[2] = { &e->latencia, &e->ttfb };
+    const char *nomes[2] = { "latencia_ms", "ttfb_ms" };
+    for (int k = 0; k < 2; k++)
+        fprintf(f, "  \"%s\": {\"media\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f},\n",
+                nomes[k], hs[k]->contagem ? hs[k]->soma / 1e3 / hs[k]->contagem : 0.0,
+                hist_quantil(hs[k], 0.5) / 1e3, hist_quantil(hs[k], 0.99) / 1e3,
+                hist_quantil(hs[k], 0.999) / 1e3, hs[k]->maximo / 1e3);
+    fprintf(f, "  \"origens\": [");
+    for (int i = 0; i < (num_origens ? num_origens : 1); i++) {
+        const EstatOrigem *o = &e->origem[i];
+        fprintf(f, "%s\n    {\"ip\": \"%s\", \"taxa_configurada_kBps\": %.2f, \"obtida_kBps\": %.2f, "
+                   "\"requisicoes\": %llu, \"bytes\": %llu}",
+                i ? "," : "", num_origens ? origens[i].texto : "padrão", num_origens ? origens[i].taxa_kBps : 0,
+                o->tempo_transf_us ? o->bytes / 1024.0 / (o->tempo_transf_us / 1e6) : 0.0,
+                (unsigned long long)o->requisicoes, (unsigned long long)o->bytes);
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+static void escrever_resumo(const Estatisticas *e, double duracao) {
+    printf("Duração: %.2f s, %llu respostas (%llu erros, %llu interrompidas)\n", duracao,
+           (unsigned long long)e->concluidas, (unsigned long long)e->erros, (unsigned long long)e->interrompidas);
+    printf("Status: 2xx=%llu 3xx=%llu 4xx=%llu 5xx=%llu; 503: %.2f%%\n", (unsigned long long)e->status[2],
+           (unsigned long long)e->status[3], (unsigned long long)e->status[4], (unsigned long long)e->status[5],
+           e->concluidas ? 100.0 * e->recusas / e->concluidas : 0.0);
+    printf("Vazão: %.1f req/s, %.1f kB/s\n", e->concluidas / duracao, e->bytes / 1024.0 / duracao);
+    printf("Latência (ms): p50 %.2f  p99 %.2f  p999 %.2f  max %.2f\n", hist_quantil(&e->latencia, 0.5) / 1e3,
+           hist_quantil(&e->latencia, 0.99) / 1e3, hist_quantil(&e->latencia, 0.999) / 1e3,
+           e->latencia.maximo / 1e3);
+    printf("Corpos divergentes dos arquivos: %llu\n", (unsigned long long)e->divergencias);
+    for (int i = 0; i < num_origens; i++) {
+        const EstatOrigem *o = &e->origem[i];
+        double obtida = o->tempo_transf_us ? o->bytes / 1024.0 / (o->tempo_transf_us / 1e6) : 0;
+        printf("  %-15s configurada %9.2f kB/s  obtida %9.2f kB/s  (%llu req)\n", origens[i].texto,
+               origens[i].taxa_kBps, obtida, (unsigned long long)o->requisicoes);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // -c N: conexões simultâneas; -t N: threads
+    // -d s: duração; -n N: total de requisições (em vez da duração)
+    // -r N: requisições por segundo no total (laço aberto; padrão: o mais rápido possível)
+    // -k N: requisições por conexão (1 = Connection: close em todas)
+    // -p caminho[=arquivo]: caminho pedido (repetível); com arquivo, o corpo é conferido
+    // -i ip: IP de origem (repetível; as conexões são distribuídas entre eles)
+    // -q arquivo: regras de QoS para comparar a banda obtida por IP com a configurada
+    // -o arquivo: resultados em JSON ("-" para a saída padrão)
+    const char *arquivo_qos = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:t:d:n:r:k:p:i:q:o:")) != -1) {
+        switch (opt) {
+        case 'c': num_conexoes = atoi(optarg); break;
+        case 't': num_threads = atoi(optarg); break;
+        case 'd': duracao_s = atof(optarg); break;
+        case 'n': total_requisicoes = atoll(optarg); break;
+        case 'r': taxa_total = atof(optarg); break;
+        case 'k': req_por_conexao = atoi(optarg); break;
+        case 'p': adicionar_alvo(optarg); break;
+        case 'i': adicionar_origem(optarg); break;
+        case 'q': arquivo_qos = optarg; break;
+        case 'o': saida_json = optarg; break;
+        default:
+            fprintf(stderr, "Uso: %s [-c conexoes] [-t threads] [-d segundos | -n requisicoes] [-r req_s] "
+                    "[-k req_por_conexao] [-p caminho[=arquivo]]... [-i ip_origem]... [-q arquivo_qos] "
+                    "[-o saida.json] [host] [porta]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (num_conexoes < 1) num_conexoes = 1;
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > num_conexoes) num_threads = num_conexoes;
+    if (req_por_conexao < 1) req_por_conexao = 1;
+    resolver_destino(optind < argc ? argv[optind] : "localhost", optind + 1 < argc ? argv[optind + 1] : "5000");
+    if (num_alvos == 0) {
+        static char padrao[] = "/";
+        adicionar_alvo(padrao);
+    }
+
+    if (arquivo_qos) {
+        TabelaQoS *qos = qos_carregar(arquivo_qos, TX_PADRAO);
+        if (!qos) {
+            perror(arquivo_qos);
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < num_origens; i++)
+            origens[i].taxa_kBps = qos_buscar_v4(qos, ntohl(origens[i].addr.s_addr));
+        qos_liberar(qos);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    atomic_init(&restantes, total_requisicoes);
+
+    Trabalhador *ts = calloc(num_threads, sizeof(Trabalhador));
+    if (!ts) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t inicio = agora_us();
+    fim_us = inicio + (uint64_t)(duracao_s * 1e6);
+    for (int k = 0, base = 0; k < num_threads; k++) {
+        Trabalhador *t = &ts[k];
+        t->num_conexoes = num_conexoes / num_threads + (k < num_conexoes % num_threads);
+        t->conexoes = calloc(t->num_conexoes, sizeof(Conexao));
+        t->livres = calloc(t->num_conexoes, sizeof(int));
+        t->pend_cap = 65536;
+        t->pendentes = calloc(t->pend_cap, sizeof(uint64_t));
+        t->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (!t->conexoes || !t->livres || !t->pendentes || t->epfd < 0) {
+            perror("Erro ao preparar as threads");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < t->num_conexoes; i++) {
+            Conexao *c = &t->conexoes[i];
+            c->fd = -1;
+            c->origem = num_origens ? (base + i) % num_origens : 0;
+            t->livres[t->num_livres++] = t->num_conexoes - 1 - i;
+        }
+        base += t->num_conexoes;
+        t->taxa = taxa_total / num_threads;
+        t->semente = (unsigned)(inicio + k);
+        pthread_create(&t->thread, NULL, trabalhar, t);
+    }
+
+    Estatisticas total = {0};
+    for (int k = 0; k < num_threads; k++) {
+        pthread_join(ts[k].thread, NULL);
+        Estatisticas *e = &ts[k].est;
+        total.iniciadas += e->iniciadas;
+        total.concluidas += e->concluidas;
+        total.recusas += e->recusas;
+        total.erros += e->erros;
+        total.divergencias += e->divergencias;
+        total.interrompidas += e->interrompidas;
+        total.bytes += e->bytes;
+        for (int i = 0; i < 6; i++) total.status[i] += e->status[i];
+        hist_somar(&total.latencia, &e->latencia);
+        hist_somar(&total.ttfb, &e->ttfb);
+        for (int i = 0; i < MAX_ORIGENS; i++) {
+            total.origem[i].requisicoes += e->origem[i].requisicoes;
+            total.origem[i].bytes += e->origem[i].bytes;
+            total.origem[i].tempo_transf_us += e->origem[i].tempo_transf_us;
+        }
+    }
+    double duracao = (agora_us() - inicio) / 1e6;
+
+    escrever_resumo(&total, duracao);
+    if (saida_json) {
+        FILE *f = strcmp(saida_json, "-") == 0 ? stdout : fopen(saida_json, "w");
+        if (!f) {
+            perror(saida_json);
+            exit(EXIT_FAILURE);
+        }
+        escrever_json(f, &total, duracao);
+        if (f != stdout) fclose(f);
+    }
+    return total.divergencias > 0 ? 2 : 0;
+}
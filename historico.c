@@ -0,0 +1,176 @@
+// historico.c
+// Histórico de requisições em anéis por thread, gravado em lotes por uma thread de fundo
+//
+// Log binário: "REQLOG1\0" seguido de registros RequisicaoInfo de 64 bytes (ordem do host)
+
+#define _GNU_SOURCE
+#include "historico.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define MAGICO "REQLOG1"   // 8 bytes com o '\0'
+#define INTERVALO_MS 50    // período de esvaziamento dos anéis
+#define BUF_JSON 65536
+
+_Static_assert(sizeof(RequisicaoInfo) == 64, "registro do log binário deve ter 64 bytes");
+
+typedef struct AnelRequisicoes {
+    _Alignas(64) _Atomic uint64_t cabeca; // próxima posição a escrever (só o produtor)
+    _Alignas(64) _Atomic uint64_t cauda;  // próxima posição a ler (só a thread de gravação)
+    _Atomic uint64_t descartados;
+    struct AnelRequisicoes *prox;
+    RequisicaoInfo itens[HISTORICO_ANEL];
+} AnelRequisicoes;
+
+static _Atomic(AnelRequisicoes *) aneis;  // lista de anéis; só cresce
+static _Thread_local AnelRequisicoes *anel_local;
+
+static int fd_bin = -1, fd_json = -1;
+static uint64_t proximo_id = 1;
+static _Atomic uint64_t total_gravados;
+
+// Primeiro registro da thread: cria o anel e o insere na lista com CAS
+static AnelRequisicoes *criar_anel(void) {
+    AnelRequisicoes *a = aligned_alloc(64, sizeof(AnelRequisicoes));
+    if (!a) return NULL;
+    atomic_init(&a->cabeca, 0);
+    atomic_init(&a->cauda, 0);
+    atomic_init(&a->descartados, 0);
+    a->prox = atomic_load(&aneis);
+    while (!atomic_compare_exchange_weak(&aneis, &a->prox, a));
+    return a;
+}
+
+void historico_registrar(const uint8_t ip[16], double rtt, double banda, int rejeitada) {
+    AnelRequisicoes *a = anel_local;
+    if (!a && !(a = anel_local = criar_anel())) return;
+
+    uint64_t cabeca = atomic_load_explicit(&a->cabeca, memory_order_relaxed);
+    if (cabeca - atomic_load_explicit(&a->cauda, memory_order_acquire) >= HISTORICO_ANEL) {
+        atomic_fetch_add_explicit(&a->descartados, 1, memory_order_relaxed);
+        return;
+    }
+    RequisicaoInfo *r = &a->itens[cabeca % HISTORICO_ANEL];
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    r->instante_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    memcpy(r->ip, ip, 16);
+    r->rtt = rtt;
+    r->bandwidth = banda;
+    r->thread_id = (uint64_t)pthread_self();
+    r->rejeitada = (uint32_t)rejeitada;
+    r->reservado = 0;
+    atomic_store_explicit(&a->cabeca, cabeca + 1, memory_order_release);
+}
+
+static void gravar_tudo(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            perror("Erro ao gravar histórico");
+            return;
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+static size_t formatar_json(char *dest, size_t cap, const RequisicaoInfo *r) {
+    char ip[INET6_ADDRSTRLEN];
+    static const uint8_t prefixo_v4[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+    if (memcmp(r->ip, prefixo_v4, 12) == 0) inet_ntop(AF_INET, r->ip + 12, ip, sizeof(ip));
+    else inet_ntop(AF_INET6, r->ip, ip, sizeof(ip));
+    int n = snprintf(dest, cap,
+                     "{\"id\":%llu,\"instante_us\":%llu,\"ip\":\"%s\",\"rtt\":%.6f,"
+                     "\"banda_kBps\":%.2f,\"thread\":%llu,\"rejeitada\":%s}\n",
+                     (unsigned long long)r->id_requisicao, (unsigned long long)r->instante_us, ip,
+                     r->rtt, r->bandwidth, (unsigned long long)r->thread_id,
+                     r->rejeitada ? "true" : "false");
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+// Esvazia um anel: numera os registros e grava os dois formatos em lote
+static void esvaziar(AnelRequisicoes *a, char *json) {
+    uint64_t cauda = atomic_load_explicit(&a->cauda, memory_order_relaxed);
+    uint64_t cabeca = atomic_load_explicit(&a->cabeca, memory_order_acquire);
+    while (cauda < cabeca) {
+        // Trecho contíguo do anel
+        size_t ini = cauda % HISTORICO_ANEL;
+        size_t n = cabeca - cauda;
+        if (n > HISTORICO_ANEL - ini) n = HISTORICO_ANEL - ini;
+        RequisicaoInfo *lote = &a->itens[ini];
+
+        size_t json_len = 0;
+        for (size_t i = 0; i < n; i++) {
+            lote[i].id_requisicao = proximo_id++;
+            if (BUF_JSON - json_len < 512) {
+                gravar_tudo(fd_json, json, json_len);
+                json_len = 0;
+            }
+            json_len += formatar_json(json + json_len, BUF_JSON - json_len, &lote[i]);
+        }
+        gravar_tudo(fd_bin, lote, n * sizeof(RequisicaoInfo));
+        gravar_tudo(fd_json, json, json_len);
+
+        atomic_fetch_add_explicit(&total_gravados, n, memory_order_relaxed);
+        cauda += n;
+        // Devolve as posições ao produtor só depois de copiadas
+        atomic_store_explicit(&a->cauda, cauda, memory_order_release);
+    }
+}
+
+static void *gravar_historico(void *arg) {
+    (void)arg;
+    char *json = malloc(BUF_JSON);
+    if (!json) return NULL;
+    while (1) {
+        struct timespec ts = { 0, INTERVALO_MS * 1000000L };
+        nanosleep(&ts, NULL);
+        for (AnelRequisicoes *a = atomic_load(&aneis); a; a = a->prox)
+            esvaziar(a, json);
+    }
+    return NULL;
+}
+
+int historico_iniciar(const char *base) {
+    char caminho[512];
+    snprintf(caminho, sizeof(caminho), "%s.bin", base);
+    fd_bin = open(caminho, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    snprintf(caminho, sizeof(caminho), "%s.jsonl", base);
+    fd_json = open(caminho, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_bin < 0 || fd_json < 0) return -1;
+
+    // Numeração continua de onde a execução anterior parou
+    struct stat st;
+    if (fstat(fd_bin, &st) == 0 && st.st_size >= (off_t)sizeof(MAGICO))
+        proximo_id = (uint64_t)(st.st_size - sizeof(MAGICO)) / sizeof(RequisicaoInfo) + 1;
+    else
+        gravar_tudo(fd_bin, MAGICO, sizeof(MAGICO));
+
+    pthread_t t;
+    if (pthread_create(&t, NULL, gravar_historico, NULL) != 0) return -1;
+    pthread_detach(t);
+    return 0;
+}
+
+uint64_t historico_gravados(void) {
+    return atomic_load_explicit(&total_gravados, memory_order_relaxed);
+}
+
+uint64_t historico_descartados(void) {
+    uint64_t total = 0;
+    for (AnelRequisicoes *a = atomic_load(&aneis); a; a = a->prox)
+        total += atomic_load_explicit(&a->descartados, memory_order_relaxed);
+    return total;
+}
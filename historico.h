@@ -0,0 +1,33 @@
+// historico.h
+// Histórico de requisições sem trava: cada thread grava num anel próprio (um produtor, um
+// consumidor) e uma thread de fundo esvazia os anéis em lotes para um log binário e um JSONL.
+// Anel cheio descarta o registro (contado) em vez de bloquear quem atende a requisição
+
+#ifndef HISTORICO_H
+#define HISTORICO_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORICO_ANEL 4096    // registros por thread ainda não gravados
+
+// Registro de tamanho fixo (64 bytes), gravado como está no log binário
+typedef struct {
+    uint64_t id_requisicao;  // sequencial, atribuído na gravação (continua entre execuções)
+    uint64_t instante_us;    // relógio de parede
+    uint8_t ip[16];          // IPv4 mapeado em IPv6
+    double rtt;
+    double bandwidth;
+    uint64_t thread_id;
+    uint32_t rejeitada;      // 1 se rejeitada
+    uint32_t reservado;
+} RequisicaoInfo;
+
+// Abre <base>.bin e <base>.jsonl (acrescentando) e inicia a thread de gravação. Retorna 0 ou -1
+int historico_iniciar(const char *base);
+void historico_registrar(const uint8_t ip[16], double rtt, double banda, int rejeitada);
+uint64_t historico_gravados(void);
+uint64_t historico_descartados(void);
+
+#endif
@@ -10,6 +10,8 @@
 #include <string.h>
 #include <fcntl.h> 
 
+#include "envio.h"
+
 int main(int argc, const char **argv)
 {
   int serverPort = 5000;
@@ -80,39 +82,15 @@ int main(int argc, const char **argv)
     }
     printf("Cabeçalhos HTTP enviados.\n");
 
-  
-    char buffer[4096];
-    size_t bytes_read;
-    long total_bytes_sent_from_file = 0; // Contador para o total de dados da imagem enviados
-    int loop_count = 0; // Contador para ver quantas vezes o loop de leitura roda
-
-    // Loop principal para ler o arquivo
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), picture)) > 0) {
-        loop_count++;
-        printf("Loop de leitura #%d: Li %zu bytes do arquivo.\n", loop_count, bytes_read);
-        
-        size_t total_sent_in_chunk = 0;
-        // Loop interno para garantir que todo o buffer seja enviado
-        while (total_sent_in_chunk < bytes_read) {
-            ssize_t sent_now = send(client_socket_fd, 
-                                    buffer + total_sent_in_chunk,
-                                    bytes_read - total_sent_in_chunk,
-                                    0);
 
-            if (sent_now < 0) {
-                perror("ERRO no envio dos dados da imagem");
-                goto cleanup; 
-            }
-            total_sent_in_chunk += sent_now;
-        }
-        total_bytes_sent_from_file += total_sent_in_chunk;
-        printf("--> Enviei um total de %zu bytes deste pedaço.\n", total_sent_in_chunk);
+    // Corpo enviado direto do arquivo para o socket (sendfile/splice), sem passar por buffer
+    if (enviar_arquivo_ritmado(client_socket_fd, fileno(picture), picture_size, 0) < 0) {
+        perror("ERRO no envio dos dados da imagem");
+        goto cleanup;
     }
-    
+
     printf("\n--- FIM DA TRANSMISSÃO ---\n");
     printf("Tamanho original do arquivo: %ld bytes\n", picture_size);
-    printf("Total de bytes da imagem enviados: %ld bytes\n", total_bytes_sent_from_file);
-    printf("O loop de leitura do arquivo rodou %d vezes.\n", loop_count);
 
 cleanup: // Rótulo para limpeza
     fclose(picture);
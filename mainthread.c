@@ -7,14 +7,100 @@
 #include <string.h>
 #include <fcntl.h>
 #include <pthread.h> 
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <errno.h>
+
+#include "envio.h"
+
+#define PROFUNDIDADE_PADRAO 1024 // conexões aceitas aguardando um worker
+
+// Política quando a fila de conexões está cheia
+typedef enum {
+    TRANSBORDO_BLOQUEAR, // a thread de accept espera uma vaga
+    TRANSBORDO_503       // responde 503 e fecha a conexão
+} PoliticaTransbordo;
+
+// Fila MPMC sem lock (anel limitado com número de sequência por posição)
+typedef struct {
+    atomic_size_t sequencia;
+    int fd;
+} CelulaFila;
+
+typedef struct {
+    CelulaFila *celulas;
+    size_t mascara;
+    _Alignas(64) atomic_size_t cauda; // próxima posição de escrita
+    _Alignas(64) atomic_size_t cabeca; // próxima posição de leitura
+    sem_t itens;  // fds disponíveis para os workers
+    sem_t vagas;  // posições livres (usado na política de bloqueio)
+} FilaConexoes;
+
+static FilaConexoes fila;
+
+void fila_iniciar(FilaConexoes *f, size_t profundidade) {
+    size_t cap = 1;
+    while (cap < profundidade) cap <<= 1;
+    f->celulas = malloc(cap * sizeof(CelulaFila));
+    if (f->celulas == NULL) {
+        perror("malloc fila failed");
+        exit(1);
+    }
+    for (size_t i = 0; i < cap; i++)
+        atomic_init(&f->celulas[i].sequencia, i);
+    f->mascara = cap - 1;
+    atomic_init(&f->cauda, 0);
+    atomic_init(&f->cabeca, 0);
+    sem_init(&f->itens, 0, 0);
+    sem_init(&f->vagas, 0, cap);
+}
 
-//lógica de comunicação com o cliente 
-void *handle_connection(void *client_socket_ptr) {
-    // 1. Receber e converter o ponteiro do socket para o tipo correto
-    int client_socket_fd = *(int*)client_socket_ptr;
-    // Libera a memória que foi alocada na main para passar o argumento
-    free(client_socket_ptr);
+// Retorna 0 se a fila está cheia
+int fila_inserir(FilaConexoes *f, int fd) {
+    size_t pos = atomic_load_explicit(&f->cauda, memory_order_relaxed);
+    while (1) {
+        CelulaFila *cel = &f->celulas[pos & f->mascara];
+        size_t seq = atomic_load_explicit(&cel->sequencia, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&f->cauda, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cel->fd = fd;
+                atomic_store_explicit(&cel->sequencia, pos + 1, memory_order_release);
+                return 1;
+            }
+        } else if (dif < 0) {
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&f->cauda, memory_order_relaxed);
+        }
+    }
+}
+
+// Retorna -1 se a fila está vazia
+int fila_remover(FilaConexoes *f) {
+    size_t pos = atomic_load_explicit(&f->cabeca, memory_order_relaxed);
+    while (1) {
+        CelulaFila *cel = &f->celulas[pos & f->mascara];
+        size_t seq = atomic_load_explicit(&cel->sequencia, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&f->cabeca, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                int fd = cel->fd;
+                atomic_store_explicit(&cel->sequencia, pos + f->mascara + 1, memory_order_release);
+                return fd;
+            }
+        } else if (dif < 0) {
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&f->cabeca, memory_order_relaxed);
+        }
+    }
+}
 
+//lógica de comunicação com o cliente 
+void handle_connection(int client_socket_fd) {
     printf("[Thread %ld] Atendendo cliente.\n", pthread_self());
 
     // --- LÓGICA DE ENVIO
@@ -24,7 +110,7 @@ void *handle_connection(void *client_socket_ptr) {
         char* error_msg = "HTTP/1.1 404 Not Found\r\n\r\n";
         send(client_socket_fd, error_msg, strlen(error_msg), 0);
         close(client_socket_fd);
-        return NULL;
+        return;
     }
 
     fseek(picture, 0, SEEK_END);
@@ -42,23 +128,14 @@ void *handle_connection(void *client_socket_ptr) {
         perror("send header failed");
         fclose(picture);
         close(client_socket_fd);
-        return NULL;
+        return;
     }
     printf("[Thread %ld] Cabeçalhos HTTP enviados.\n", pthread_self());
 
-    char buffer[4096];
-    size_t bytes_read;
-
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), picture)) > 0) {
-        size_t total_sent_in_chunk = 0;
-        while (total_sent_in_chunk < bytes_read) {
-            ssize_t sent_now = send(client_socket_fd, buffer + total_sent_in_chunk, bytes_read - total_sent_in_chunk, 0);
-            if (sent_now < 0) {
-                perror("send picture data failed");
-                goto cleanup;
-            }
-            total_sent_in_chunk += sent_now;
-        }
+    // Corpo enviado direto do arquivo para o socket (sendfile/splice), sem buffer próprio
+    if (enviar_arquivo_ritmado(client_socket_fd, fileno(picture), picture_size, 0) < 0) {
+        perror("send picture data failed");
+        goto cleanup;
     }
     printf("[Thread %ld] Dados da foto enviados. Tamanho: %ld bytes\n", pthread_self(), picture_size);
 
@@ -67,12 +144,43 @@ cleanup:
     shutdown(client_socket_fd, SHUT_WR);
     close(client_socket_fd);
     printf("[Thread %ld] Conexão com o cliente fechada.\n", pthread_self());
+}
+
+// Worker do pool: retira conexões da fila e as atende até o fim
+void *worker(void *arg) {
+    (void)arg;
+    while (1) {
+        while (sem_wait(&fila.itens) != 0 && errno == EINTR);
+        int client_socket_fd = fila_remover(&fila);
+        sem_post(&fila.vagas);
+        if (client_socket_fd >= 0)
+            handle_connection(client_socket_fd);
+    }
     return NULL;
 }
 
-int main(int argc, const char **argv)
+int main(int argc, char **argv)
 {
   int serverPort = 5000;
+  int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  size_t profundidade = PROFUNDIDADE_PADRAO;
+  PoliticaTransbordo politica = TRANSBORDO_BLOQUEAR;
+
+  // -w workers, -q profundidade da fila, -o bloquear|503
+  int opt;
+  while ((opt = getopt(argc, argv, "w:q:o:")) != -1) {
+    switch (opt) {
+    case 'w': num_workers = atoi(optarg); break;
+    case 'q': profundidade = (size_t)atol(optarg); break;
+    case 'o': politica = (strcmp(optarg, "503") == 0) ? TRANSBORDO_503 : TRANSBORDO_BLOQUEAR; break;
+    default:
+      fprintf(stderr, "Uso: %s [-w workers] [-q profundidade] [-o bloquear|503]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (num_workers < 1) num_workers = 1;
+  if (profundidade < 1) profundidade = 1;
+
   int s = socket(PF_INET, SOCK_STREAM, 0);
   int on = 1;
   setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
@@ -94,6 +202,19 @@ int main(int argc, const char **argv)
   }
   printf("Servidor escutando na porta %d. Aguardando conexões...\n", serverPort);
 
+  // --- POOL DE WORKERS: criado uma vez, alimentado pela fila de conexões ---
+  fila_iniciar(&fila, profundidade);
+  for (int i = 0; i < num_workers; i++) {
+    pthread_t thread_id;
+    if (pthread_create(&thread_id, NULL, worker, NULL) != 0) {
+      perror("pthread_create failed");
+      exit(1);
+    }
+    pthread_detach(thread_id);
+  }
+  printf("[Main] %d workers, fila de %zu conexões, transbordo: %s\n", num_workers,
+         fila.mascara + 1, politica == TRANSBORDO_503 ? "503" : "bloquear");
+
   while (1)
   {
     struct sockaddr_in clientSa;
@@ -105,22 +226,21 @@ int main(int argc, const char **argv)
       continue;
     }
 
-    printf("[Main] Cliente conectado: %s. Criando thread para atendê-lo.\n", inet_ntoa(clientSa.sin_addr));
-
-    // --- LÓGICA DE CRIAÇÃO DE THREADS ---
-    pthread_t thread_id;
-    // Aloca memória para passar o descritor do socket para a thread
-    int *client_socket_ptr = malloc(sizeof(int));
-    *client_socket_ptr = client_socket_fd;
-
-    // Cria a nova thread, passando a função 'handle_connection' e o ponteiro do socket
-    if (pthread_create(&thread_id, NULL, handle_connection, (void*)client_socket_ptr) != 0) {
-        perror("pthread_create failed");
-        free(client_socket_ptr);
-        close(client_socket_fd);
+    printf("[Main] Cliente conectado: %s. Enfileirando para o pool.\n", inet_ntoa(clientSa.sin_addr));
+
+    // --- LÓGICA DE ENFILEIRAMENTO ---
+    if (politica == TRANSBORDO_BLOQUEAR) {
+      // Espera uma vaga: o accept para de avançar enquanto o pool está saturado
+      while (sem_wait(&fila.vagas) != 0 && errno == EINTR);
+    } else if (sem_trywait(&fila.vagas) != 0) {
+      char* busy_msg = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+      send(client_socket_fd, busy_msg, strlen(busy_msg), MSG_NOSIGNAL);
+      close(client_socket_fd);
+      printf("[Main] Fila cheia: 503 para %s.\n", inet_ntoa(clientSa.sin_addr));
+      continue;
     }
-    // Desanexa a thread para que seus recursos sejam liberados automaticamente ao terminar
-    pthread_detach(thread_id);
+    fila_inserir(&fila, client_socket_fd);
+    sem_post(&fila.itens);
   }
 
   close(s);
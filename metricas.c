@@ -0,0 +1,166 @@
+// metricas.c
+// Contadores e histogramas HDR por thread, exportados no formato do Prometheus
+
+#include "metricas.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Histograma log-linear: valores < 128 exatos; acima, 64 sub-baldes por potência de 2
+// (erro relativo < 1,6%). Cobre até 2^41
+#define SUB_BALDES 64
+#define MAX_EXPOENTE 34
+#define NUM_BALDES (SUB_BALDES * (MAX_EXPOENTE + 1) + SUB_BALDES)
+#define MAX_STATUS 600
+
+typedef struct {
+    _Atomic uint64_t baldes[NUM_BALDES];
+    _Atomic uint64_t contagem, soma, maximo;
+} HistogramaHdr;
+
+typedef struct MetricasThread {
+    _Atomic uint64_t contadores[NUM_CONTADORES];
+    _Atomic uint64_t status[MAX_STATUS];
+    HistogramaHdr hist[NUM_HISTOGRAMAS];
+    struct MetricasThread *prox;
+} MetricasThread;
+
+static _Atomic(MetricasThread *) todas; // lista de threads; só cresce
+static _Thread_local MetricasThread *locais;
+
+static const char *nomes_hist[NUM_HISTOGRAMAS][2] = {
+    { "servidor_latencia_segundos", "Tempo da requisição completa ao fim da resposta" },
+    { "servidor_ttfb_segundos", "Tempo da requisição completa ao primeiro byte enviado" },
+    { "servidor_banda_kBps", "Taxa obtida por transferência concluída" },
+    { "servidor_espera_admissao_segundos", "Tempo na fila de admissão até a banda ser concedida" },
+};
+static const double escala_hist[NUM_HISTOGRAMAS] = { 1e-6, 1e-6, 1, 1e-6 };
+
+static const char *nomes_cont[NUM_CONTADORES][2] = {
+    { "servidor_bytes_enviados_total", "Bytes de corpo enviados" },
+    { "servidor_recusas_total", "Requisições recusadas com 503 por falta de banda" },
+    { "servidor_esperas_expiradas_total", "Recusas depois de esperar o prazo máximo na fila de admissão" },
+    { "servidor_conexoes_aceitas_total", "Conexões aceitas" },
+    { "servidor_conexoes_fechadas_total", "Conexões fechadas" },
+    { "servidor_prazos_leitura_total", "Conexões fechadas por não enviarem a requisição no prazo" },
+    { "servidor_prazos_escrita_total", "Conexões fechadas por pararem de ler a resposta" },
+};
+
+static MetricasThread *minhas(void) {
+    MetricasThread *m = locais;
+    if (m) return m;
+    m = calloc(1, sizeof(MetricasThread));
+    if (!m) abort();
+    m->prox = atomic_load(&todas);
+    while (!atomic_compare_exchange_weak(&todas, &m->prox, m));
+    return locais = m;
+}
+
+// Só a própria thread escreve: carga + armazenamento relaxados bastam
+static inline void somar(_Atomic uint64_t *x, uint64_t n) {
+    atomic_store_explicit(x, atomic_load_explicit(x, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static int indice_balde(uint64_t v) {
+    if (v < 2 * SUB_BALDES) return (int)v;
+    int e = 63 - __builtin_clzll(v) - 6; // v >> e fica em [64, 128)
+    if (e > MAX_EXPOENTE) return NUM_BALDES - 1;
+    return SUB_BALDES * e + (int)(v >> e);
+}
+
+// Maior valor que cai no balde (o quantil é reportado pelo limite superior)
+static uint64_t valor_balde(int i) {
+    if (i < 2 * SUB_BALDES) return (uint64_t)i;
+    int e = i / SUB_BALDES - 1;
+    uint64_t m = (uint64_t)(i % SUB_BALDES + SUB_BALDES);
+    return ((m + 1) << e) - 1;
+}
+
+void metricas_contar(Contador c, uint64_t n) {
+    somar(&minhas()->contadores[c], n);
+}
+
+void metricas_status(int status) {
+    if (status > 0 && status < MAX_STATUS) somar(&minhas()->status[status], 1);
+}
+
+void metricas_registrar(Histograma h, uint64_t valor) {
+    HistogramaHdr *hh = &minhas()->hist[h];
+    somar(&hh->baldes[indice_balde(valor)], 1);
+    somar(&hh->contagem, 1);
+    somar(&hh->soma, valor);
+    if (valor > atomic_load_explicit(&hh->maximo, memory_order_relaxed))
+        atomic_store_explicit(&hh->maximo, valor, memory_order_relaxed);
+}
+
+void metricas_texto(TextoMetricas *t, const char *fmt, ...) {
+    size_t livre = t->len < t->cap ? t->cap - t->len : 0;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(livre ? t->buf + t->len : NULL, livre, fmt, ap);
+    va_end(ap);
+    if (n > 0) t->len += (size_t)n;
+}
+
+static uint64_t ler(_Atomic uint64_t *x) {
+    return atomic_load_explicit(x, memory_order_relaxed);
+}
+
+static void escrever_histograma(TextoMetricas *t, Histograma h) {
+    uint64_t baldes[NUM_BALDES] = { 0 };
+    uint64_t contagem = 0, soma = 0, maximo = 0;
+    for (MetricasThread *m = atomic_load(&todas); m; m = m->prox) {
+        HistogramaHdr *hh = &m->hist[h];
+        for (int i = 0; i < NUM_BALDES; i++) baldes[i] += ler(&hh->baldes[i]);
+        soma += ler(&hh->soma);
+        uint64_t mx = ler(&hh->maximo);
+        if (mx > maximo) maximo = mx;
+    }
+    // Contagem somada dos baldes: coerente com os quantis mesmo durante escritas
+    for (int i = 0; i < NUM_BALDES; i++) contagem += baldes[i];
+
+    const char *nome = nomes_hist[h][0];
+    double escala = escala_hist[h];
+    metricas_texto(t, "# HELP %s %s\n# TYPE %s summary\n", nome, nomes_hist[h][1], nome);
+    static const double quantis[] = { 0.5, 0.9, 0.99, 0.999 };
+    int i = 0;
+    uint64_t acumulado = 0;
+    for (size_t q = 0; q < sizeof(quantis) / sizeof(quantis[0]); q++) {
+        uint64_t alvo = (uint64_t)(quantis[q] * contagem + 0.5);
+        if (alvo == 0) alvo = 1;
+        while (i < NUM_BALDES && acumulado + baldes[i] < alvo) acumulado += baldes[i++];
+        uint64_t v = contagem ? valor_balde(i < NUM_BALDES ? i : NUM_BALDES - 1) : 0;
+        if (v > maximo) v = maximo;
+        metricas_texto(t, "%s{quantile=\"%g\"} %g\n", nome, quantis[q], v * escala);
+    }
+    metricas_texto(t, "%s{quantile=\"1\"} %g\n", nome, maximo * escala);
+    metricas_texto(t, "%s_sum %g\n%s_count %llu\n", nome, soma * escala, nome, (unsigned long long)contagem);
+}
+
+void metricas_escrever(TextoMetricas *t) {
+    for (int c = 0; c < NUM_CONTADORES; c++) {
+        uint64_t total = 0;
+        for (MetricasThread *m = atomic_load(&todas); m; m = m->prox) total += ler(&m->contadores[c]);
+        metricas_texto(t, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+                       nomes_cont[c][0], nomes_cont[c][1], nomes_cont[c][0], nomes_cont[c][0],
+                       (unsigned long long)total);
+    }
+
+    uint64_t abertas = 0;
+    for (MetricasThread *m = atomic_load(&todas); m; m = m->prox)
+        abertas += ler(&m->contadores[CONT_CONEXOES_ACEITAS]) - ler(&m->contadores[CONT_CONEXOES_FECHADAS]);
+    metricas_texto(t, "# HELP servidor_conexoes_abertas Conexões abertas agora\n"
+                      "# TYPE servidor_conexoes_abertas gauge\nservidor_conexoes_abertas %lld\n", (long long)abertas);
+
+    metricas_texto(t, "# HELP servidor_respostas_total Respostas por status HTTP\n"
+                      "# TYPE servidor_respostas_total counter\n");
+    for (int s = 100; s < MAX_STATUS; s++) {
+        uint64_t total = 0;
+        for (MetricasThread *m = atomic_load(&todas); m; m = m->prox) total += ler(&m->status[s]);
+        if (total) metricas_texto(t, "servidor_respostas_total{status=\"%d\"} %llu\n", s, (unsigned long long)total);
+    }
+
+    for (int h = 0; h < NUM_HISTOGRAMAS; h++) escrever_histograma(t, (Histograma)h);
+}
@@ -0,0 +1,47 @@
+// metricas.h
+// Métricas do servidor: contadores e histogramas HDR por thread, somados só na leitura.
+// Cada thread escreve apenas nas suas métricas (sem trava nem RMW atômico); quem exporta
+// lê todas com cargas relaxadas, sem bloquear ninguém
+
+#ifndef METRICAS_H
+#define METRICAS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    HIST_LATENCIA_US,  // da requisição completa ao último byte da resposta
+    HIST_TTFB_US,      // da requisição completa ao primeiro byte enviado
+    HIST_BANDA_KBPS,   // taxa obtida em cada transferência concluída
+    HIST_ESPERA_US,    // tempo na fila de admissão até a banda ser concedida
+    NUM_HISTOGRAMAS
+} Histograma;
+
+typedef enum {
+    CONT_BYTES_ENVIADOS,
+    CONT_RECUSAS,      // 503 por falta de banda
+    CONT_ESPERAS_EXPIRADAS, // 503 depois de esperar o prazo máximo na fila
+    CONT_CONEXOES_ACEITAS,
+    CONT_CONEXOES_FECHADAS,
+    CONT_PRAZOS_LEITURA, // fechadas sem mandar a requisição inteira no prazo do cabeçalho
+    CONT_PRAZOS_ESCRITA, // fechadas com o envio parado (cliente sem ler) pelo prazo de escrita
+    NUM_CONTADORES
+} Contador;
+
+void metricas_contar(Contador c, uint64_t n);
+void metricas_status(int status);
+void metricas_registrar(Histograma h, uint64_t valor);
+
+// Texto montado num buffer de quem chama, sem alocar. Como no snprintf, 'len' continua somando
+// além de 'cap': len >= cap indica que o texto não coube
+typedef struct {
+    char *buf;
+    size_t cap, len;
+} TextoMetricas;
+
+void metricas_texto(TextoMetricas *t, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+// Texto no formato de exposição do Prometheus (contadores e resumos com quantis)
+// Medidas globais do servidor (vazão etc.) são acrescentadas por quem chama
+void metricas_escrever(TextoMetricas *t);
+
+#endif
@@ -0,0 +1,38 @@
+// orcamento_banda.c
+// Orçamento de banda do servidor sem trava
+
+#include "orcamento_banda.h"
+
+int64_t orcamento_Bps(double taxa_kBps) {
+    return (int64_t)(taxa_kBps * 1024.0 + 0.5);
+}
+
+void orcamento_iniciar(OrcamentoBanda *o, double maximo_kBps) {
+    atomic_init(&o->usado, 0);
+    o->maximo = orcamento_Bps(maximo_kBps);
+}
+
+int orcamento_reservar(OrcamentoBanda *o, int64_t Bps) {
+    int64_t usado = atomic_load_explicit(&o->usado, memory_order_relaxed);
+    do {
+        if (usado + Bps > o->maximo) return 0;
+    } while (!atomic_compare_exchange_weak_explicit(&o->usado, &usado, usado + Bps,
+                                                    memory_order_acq_rel, memory_order_relaxed));
+    return 1;
+}
+
+void orcamento_liberar(OrcamentoBanda *o, int64_t Bps) {
+    atomic_fetch_sub_explicit(&o->usado, Bps, memory_order_release);
+}
+
+int orcamento_ajustar(OrcamentoBanda *o, int64_t antigo, int64_t novo) {
+    if (novo <= antigo) {
+        orcamento_liberar(o, antigo - novo);
+        return 1;
+    }
+    return orcamento_reservar(o, novo - antigo);
+}
+
+double orcamento_usado_kBps(OrcamentoBanda *o) {
+    return atomic_load_explicit(&o->usado, memory_order_relaxed) / 1024.0;
+}
@@ -0,0 +1,25 @@
+// orcamento_banda.h
+// Orçamento de banda do servidor sem trava: reservas em bytes/s feitas com compare-and-swap.
+// A soma das reservas nunca passa do máximo, mesmo com várias threads admitindo ao mesmo tempo
+
+#ifndef ORCAMENTO_BANDA_H
+#define ORCAMENTO_BANDA_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+typedef struct {
+    _Alignas(64) _Atomic int64_t usado; // linha de cache própria: só ela é disputada
+    int64_t maximo;                     // bytes/s
+} OrcamentoBanda;
+
+int64_t orcamento_Bps(double taxa_kBps);
+void orcamento_iniciar(OrcamentoBanda *o, double maximo_kBps);
+// Reserva 'Bps' se couber no orçamento. Retorna 1 se reservou, 0 se recusou
+int orcamento_reservar(OrcamentoBanda *o, int64_t Bps);
+void orcamento_liberar(OrcamentoBanda *o, int64_t Bps);
+// Troca uma reserva 'antigo' por 'novo'; aumentos podem ser recusados (a reserva antiga fica)
+int orcamento_ajustar(OrcamentoBanda *o, int64_t antigo, int64_t novo);
+double orcamento_usado_kBps(OrcamentoBanda *o);
+
+#endif
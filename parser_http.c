@@ -0,0 +1,262 @@
+// parser_http.c
+// Parser incremental de requisições HTTP/1.x
+
+#define _GNU_SOURCE
+#include "parser_http.h"
+
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+enum {
+    P_METODO,
+    P_ALVO,
+    P_VERSAO,
+    P_VERSAO_LF,
+    P_NOME_INICIO,
+    P_NOME,
+    P_VALOR_INICIO,
+    P_VALOR,
+    P_VALOR_LF,
+    P_FIM_LF
+};
+
+void parser_iniciar(ParserHttp *p) {
+    memset(p, 0, sizeof(*p));
+    p->estado = P_METODO;
+}
+
+static Trecho trecho(size_t inicio, size_t fim) {
+    Trecho t = { (uint32_t)inicio, (uint32_t)(fim - inicio) };
+    return t;
+}
+
+// Cabeçalhos que o servidor usa; os demais são apenas pulados
+static Trecho *cabecalho_conhecido(ParserHttp *p, const char *nome, size_t len) {
+    switch (len) {
+    case 4:  return strncasecmp(nome, "Host", 4) == 0 ? &p->host : NULL;
+    case 5:  return strncasecmp(nome, "Range", 5) == 0 ? &p->range : NULL;
+    case 8:  return strncasecmp(nome, "If-Range", 8) == 0 ? &p->if_range : NULL;
+    case 10: return strncasecmp(nome, "Connection", 10) == 0 ? &p->connection : NULL;
+    case 13: return strncasecmp(nome, "If-None-Match", 13) == 0 ? &p->if_none_match : NULL;
+    case 14: return strncasecmp(nome, "Content-Length", 14) == 0 ? &p->content_length : NULL;
+    case 15: return strncasecmp(nome, "Accept-Encoding", 15) == 0 ? &p->accept_encoding : NULL;
+    case 17:
+        if (strncasecmp(nome, "If-Modified-Since", 17) == 0) return &p->if_modified_since;
+        return strncasecmp(nome, "Transfer-Encoding", 17) == 0 ? &p->transfer_encoding : NULL;
+    default: return NULL;
+    }
+}
+
+static ResultadoParser falhar(ParserHttp *p, int status) {
+    p->erro = status;
+    return PARSER_ERRO;
+}
+
+ResultadoParser parser_executar(ParserHttp *p, const char *buf, size_t len) {
+    size_t i = p->pos;
+    while (i < len) {
+        unsigned char ch = (unsigned char)buf[i];
+        switch (p->estado) {
+        case P_METODO:
+            if (ch == ' ') {
+                if (i == p->marca) return falhar(p, 400);
+                p->metodo = trecho(p->marca, i);
+                p->marca = i + 1;
+                p->estado = P_ALVO;
+            } else if (ch < 'A' || ch > 'Z' || i - p->marca >= PARSER_MAX_METODO) {
+                return falhar(p, 400);
+            }
+            break;
+
+        case P_ALVO: {
+            // Procura o fim do alvo de uma vez
+            const char *esp = memchr(buf + i, ' ', len - i);
+            size_t fim = esp ? (size_t)(esp - buf) : len;
+            for (size_t k = i; k < fim; k++)
+                if ((unsigned char)buf[k] <= 0x20 || buf[k] == 0x7f) return falhar(p, 400);
+            if (fim - p->marca > PARSER_MAX_ALVO) return falhar(p, 414);
+            if (!esp) {
+                i = len;
+                continue;
+            }
+            if (fim == p->marca) return falhar(p, 400);
+            p->alvo = trecho(p->marca, fim);
+            p->marca = fim + 1;
+            p->estado = P_VERSAO;
+            i = fim;
+            break;
+        }
+
+        case P_VERSAO:
+            if (ch == '\r' || ch == '\n') {
+                size_t n = i - p->marca;
+                const char *v = buf + p->marca;
+                if (n != 8 || memcmp(v, "HTTP/1.", 7) != 0 || v[7] < '0' || v[7] > '9')
+                    return falhar(p, 505);
+                p->versao_menor = v[7] - '0';
+                p->estado = (ch == '\r') ? P_VERSAO_LF : P_NOME_INICIO;
+            } else if (i - p->marca >= 8) {
+                return falhar(p, 505);
+            }
+            break;
+
+        case P_VERSAO_LF:
+        case P_VALOR_LF:
+            if (ch != '\n') return falhar(p, 400);
+            p->estado = P_NOME_INICIO;
+            break;
+
+        case P_NOME_INICIO:
+            if (ch == '\r') {
+                p->estado = P_FIM_LF;
+            } else if (ch == '\n') {
+                p->fim = i + 1;
+                p->pos = p->fim;
+                return PARSER_OK;
+            } else {
+                p->marca = i;
+                p->estado = P_NOME;
+                continue; // reprocessa o byte como parte do nome
+            }
+            break;
+
+        case P_NOME:
+            if (ch == ':') {
+                if (i == p->marca) return falhar(p, 400);
+                p->atual = cabecalho_conhecido(p, buf + p->marca, i - p->marca);
+                p->estado = P_VALOR_INICIO;
+            } else if (ch <= 0x20 || ch == 0x7f) {
+                return falhar(p, 400);
+            }
+            break;
+
+        case P_VALOR_INICIO:
+            if (ch == ' ' || ch == '\t') break;
+            p->marca = i;
+            p->estado = P_VALOR;
+            continue;
+
+        case P_VALOR: {
+            // O valor termina no CRLF ou, como na linha de requisição, num LF sozinho
+            const char *lf = memchr(buf + i, '\n', len - i);
+            const char *cr = memchr(buf + i, '\r', (lf ? (size_t)(lf - buf) : len) - i);
+            const char *fim_valor = cr ? cr : lf;
+            if (!fim_valor) {
+                i = len;
+                continue;
+            }
+            size_t fim = (size_t)(fim_valor - buf);
+            if (p->atual) {
+                size_t f = fim;
+                while (f > p->marca && (buf[f - 1] == ' ' || buf[f - 1] == '\t')) f--;
+                *p->atual = trecho(p->marca, f);
+            }
+            p->estado = cr ? P_VALOR_LF : P_NOME_INICIO;
+            i = fim;
+            break;
+        }
+
+        case P_FIM_LF:
+            if (ch != '\n') return falhar(p, 400);
+            p->fim = i + 1;
+            p->pos = p->fim;
+            return PARSER_OK;
+        }
+        i++;
+    }
+    p->pos = i;
+    return PARSER_INCOMPLETO;
+}
+
+int trecho_igual(const char *buf, Trecho t, const char *s) {
+    size_t n = strlen(s);
+    return t.len == n && memcmp(buf + t.inicio, s, n) == 0;
+}
+
+int trecho_contem_token(const char *buf, Trecho t, const char *token) {
+    size_t n = strlen(token);
+    const char *v = buf + t.inicio;
+    size_t i = 0;
+    while (i < t.len) {
+        while (i < t.len && (v[i] == ' ' || v[i] == '\t' || v[i] == ',')) i++;
+        size_t ini = i;
+        while (i < t.len && v[i] != ',' && v[i] != ';') i++;
+        size_t fim = i;
+        while (fim > ini && (v[fim - 1] == ' ' || v[fim - 1] == '\t')) fim--;
+        if (fim - ini == n && strncasecmp(v + ini, token, n) == 0) return 1;
+        while (i < t.len && v[i] != ',') i++; // pula parâmetros (;q=...)
+    }
+    return 0;
+}
+
+// "q=0.5" -> 500; valores fora do formato contam como 1
+static int ler_qualidade(const char *v, size_t len) {
+    if (len < 2 || (v[0] != 'q' && v[0] != 'Q') || v[1] != '=') return 1000;
+    if (len < 3 || v[2] == '1') return 1000;
+    int q = 0, casas = 0;
+    for (size_t i = 4; i < len && casas < 3 && v[i] >= '0' && v[i] <= '9'; i++, casas++)
+        q = q * 10 + (v[i] - '0');
+    while (casas++ < 3) q *= 10;
+    return q;
+}
+
+int trecho_qualidade(const char *buf, Trecho t, const char *token) {
+    size_t n = strlen(token);
+    const char *v = buf + t.inicio;
+    int q_token = -1, q_todos = -1;
+    size_t i = 0;
+    while (i < t.len) {
+        while (i < t.len && (v[i] == ' ' || v[i] == '\t' || v[i] == ',')) i++;
+        size_t ini = i;
+        while (i < t.len && v[i] != ',' && v[i] != ';' && v[i] != ' ' && v[i] != '\t') i++;
+        size_t fim = i;
+        int q = 1000;
+        while (i < t.len && v[i] != ',') {
+            if (v[i] == ';') {
+                i++;
+                while (i < t.len && (v[i] == ' ' || v[i] == '\t')) i++;
+                size_t p = i;
+                while (i < t.len && v[i] != ',' && v[i] != ';') i++;
+                q = ler_qualidade(v + p, i - p);
+                continue;
+            }
+            i++;
+        }
+        if (fim - ini == n && strncasecmp(v + ini, token, n) == 0) q_token = q;
+        else if (fim - ini == 1 && v[ini] == '*') q_todos = q;
+    }
+    if (q_token >= 0) return q_token;
+    return q_todos >= 0 ? q_todos : 0;
+}
+
+int trecho_contem_etag(const char *buf, Trecho t, const char *etag) {
+    size_t n = strlen(etag);
+    const char *v = buf + t.inicio;
+    size_t i = 0;
+    while (i < t.len) {
+        while (i < t.len && (v[i] == ' ' || v[i] == '\t' || v[i] == ',')) i++;
+        if (i < t.len && v[i] == '*') return 1;
+        if (t.len - i >= 2 && v[i] == 'W' && v[i + 1] == '/') i += 2;
+        size_t ini = i;
+        if (i < t.len && v[i] == '"') { // a etiqueta vai até as aspas finais (pode conter vírgulas)
+            const char *fim = memchr(v + i + 1, '"', t.len - i - 1);
+            i = fim ? (size_t)(fim - v) + 1 : t.len;
+        }
+        if (i - ini == n && memcmp(v + ini, etag, n) == 0) return 1;
+        while (i < t.len && v[i] != ',') i++;
+    }
+    return 0;
+}
+
+int trecho_data(const char *buf, Trecho t, time_t *data) {
+    char texto[64];
+    if (t.len == 0 || t.len >= sizeof(texto)) return 0;
+    memcpy(texto, buf + t.inicio, t.len);
+    texto[t.len] = '\0';
+    struct tm tm = {0};
+    const char *fim = strptime(texto, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!fim || *fim != '\0') return 0;
+    *data = timegm(&tm);
+    return 1;
+}
@@ -0,0 +1,56 @@
+// parser_http.h
+// Parser incremental de requisições HTTP/1.x
+// Não copia nada: guarda posições (início, tamanho) dentro do buffer da conexão e
+// retoma de onde parou quando chegam mais bytes
+
+#ifndef PARSER_HTTP_H
+#define PARSER_HTTP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define PARSER_MAX_METODO 16
+#define PARSER_MAX_ALVO 2048
+
+typedef struct {
+    uint32_t inicio, len; // trecho do buffer; len == 0 quando ausente
+} Trecho;
+
+typedef enum {
+    PARSER_INCOMPLETO, // faltam bytes: chame de novo quando chegarem mais
+    PARSER_OK,         // requisição completa em [0, fim)
+    PARSER_ERRO        // requisição malformada (status sugerido em 'erro')
+} ResultadoParser;
+
+typedef struct {
+    int estado;
+    size_t pos;       // próximo byte a examinar
+    size_t marca;     // início do token atual
+    Trecho *atual;    // cabeçalho conhecido cujo valor está sendo lido (ou NULL)
+
+    Trecho metodo, alvo;
+    int versao_menor; // HTTP/1.<versao_menor>
+    Trecho host, range, if_range, if_none_match, if_modified_since, connection, accept_encoding;
+    Trecho content_length, transfer_encoding; // só para saber se a requisição traz corpo
+    size_t fim;       // tamanho total da requisição (até o CRLF vazio)
+    int erro;         // 400, 414, 505...
+} ParserHttp;
+
+void parser_iniciar(ParserHttp *p);
+// 'buf' é sempre o início da requisição; 'len' pode crescer entre as chamadas
+ResultadoParser parser_executar(ParserHttp *p, const char *buf, size_t len);
+
+// Compara o trecho com uma string (exato)
+int trecho_igual(const char *buf, Trecho t, const char *s);
+// Procura 'token' numa lista separada por vírgulas, sem diferenciar maiúsculas
+int trecho_contem_token(const char *buf, Trecho t, const char *token);
+// Peso (q) de 'token' numa lista como Accept-Encoding, em milésimos: 1000 sem q explícito,
+// o peso de "*" se o token não aparece e 0 se nenhum dos dois aparece
+int trecho_qualidade(const char *buf, Trecho t, const char *token);
+// If-None-Match: 1 se a lista tem "*" ou uma etiqueta igual a 'etag' (comparação fraca: ignora W/)
+int trecho_contem_etag(const char *buf, Trecho t, const char *etag);
+// Lê uma data HTTP (IMF-fixdate, ex: "Sun, 06 Nov 1994 08:49:37 GMT"). Retorna 1 se válida
+int trecho_data(const char *buf, Trecho t, time_t *data);
+
+#endif
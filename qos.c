@@ -0,0 +1,258 @@
+// qos.c
+// Regras de QoS por sub-rede (CIDR) com casamento pelo prefixo mais longo
+
+#define _GNU_SOURCE
+#include "qos.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#define BITS_RAIZ 16
+#define BITS_NO 8
+#define FILHO 0x80000000u // entrada aponta para um nó; sem o bit, é índice da taxa + 1 (0 = sem regra)
+
+typedef struct {
+    uint8_t endereco[16];
+    uint8_t familia_v6;
+    uint8_t prefixo;
+    uint32_t ordem;  // posição no arquivo, desempata regras repetidas
+    double taxa_kBps;
+} RegraQoS;
+
+typedef struct {
+    uint32_t *raiz;  // 2^16 entradas
+    uint32_t *nos;   // blocos de 2^8 entradas
+    size_t num_nos, cap_nos;
+} TrieQoS;
+
+struct TabelaQoS {
+    double taxa_padrao;
+    RegraQoS *regras;
+    size_t num_regras, cap_regras;
+    double *taxas;   // taxa de cada regra, indexada pelas entradas da trie
+    TrieQoS v4, v6;
+};
+
+TabelaQoS *qos_criar(double taxa_padrao) {
+    TabelaQoS *t = calloc(1, sizeof(TabelaQoS));
+    if (t) t->taxa_padrao = taxa_padrao;
+    return t;
+}
+
+static void liberar_trie(TrieQoS *trie) {
+    free(trie->raiz);
+    free(trie->nos);
+    memset(trie, 0, sizeof(*trie));
+}
+
+void qos_liberar(TabelaQoS *t) {
+    if (!t) return;
+    liberar_trie(&t->v4);
+    liberar_trie(&t->v6);
+    free(t->regras);
+    free(t->taxas);
+    free(t);
+}
+
+size_t qos_num_regras(const TabelaQoS *t) {
+    return t ? t->num_regras : 0;
+}
+
+int qos_adicionar(TabelaQoS *t, int familia, const uint8_t *endereco, int prefixo, double taxa_kBps) {
+    int bits = (familia == AF_INET6) ? 128 : 32;
+    if (prefixo < 0 || prefixo > bits) return -1;
+    if (t->num_regras == t->cap_regras) {
+        size_t cap = t->cap_regras ? t->cap_regras * 2 : 64;
+        RegraQoS *novo = realloc(t->regras, cap * sizeof(RegraQoS));
+        if (!novo) return -1;
+        t->regras = novo;
+        t->cap_regras = cap;
+    }
+    RegraQoS *r = &t->regras[t->num_regras++];
+    memset(r, 0, sizeof(*r));
+    memcpy(r->endereco, endereco, bits / 8);
+    // Zera os bits de host (10.1.2.3/8 vira 10.0.0.0/8)
+    for (int b = prefixo; b < bits; b++)
+        r->endereco[b / 8] &= (uint8_t)~(0x80 >> (b % 8));
+    r->familia_v6 = (familia == AF_INET6);
+    r->prefixo = (uint8_t)prefixo;
+    r->ordem = (uint32_t)(t->num_regras - 1);
+    r->taxa_kBps = taxa_kBps;
+    return 0;
+}
+
+static int64_t novo_no(TrieQoS *trie, uint32_t herdado) {
+    if (trie->num_nos == trie->cap_nos) {
+        size_t cap = trie->cap_nos ? trie->cap_nos * 2 : 64;
+        if (cap >= FILHO) return -1;
+        uint32_t *novo = realloc(trie->nos, cap * (1 << BITS_NO) * sizeof(uint32_t));
+        if (!novo) return -1;
+        trie->nos = novo;
+        trie->cap_nos = cap;
+    }
+    uint32_t *no = &trie->nos[trie->num_nos * (1 << BITS_NO)];
+    for (int i = 0; i < (1 << BITS_NO); i++) no[i] = herdado;
+    return (int64_t)trie->num_nos++;
+}
+
+// Lê 'n' bits do endereço a partir do bit 'inicio'
+static uint32_t extrair_bits(const uint8_t *end, int inicio, int n) {
+    uint32_t v = 0;
+    for (int b = inicio; b < inicio + n; b++)
+        v = (v << 1) | ((end[b / 8] >> (7 - b % 8)) & 1);
+    return v;
+}
+
+// Regras chegam em ordem crescente de prefixo: uma entrada nunca tem filho quando recebe
+// uma regra mais curta, então o leaf pushing é só copiar o valor para o nó novo
+static int inserir(TrieQoS *trie, const RegraQoS *r, uint32_t valor) {
+    uint32_t *tabela = trie->raiz;
+    int inicio = 0, passo = BITS_RAIZ;
+    while (r->prefixo > inicio + passo) {
+        uint32_t idx = extrair_bits(r->endereco, inicio, passo);
+        if (!(tabela[idx] & FILHO)) {
+            size_t desloc = (size_t)(tabela - trie->nos); // realloc pode mover os nós
+            int eh_raiz = (tabela == trie->raiz);
+            int64_t no = novo_no(trie, tabela[idx]);
+            if (no < 0) return -1;
+            if (!eh_raiz) tabela = trie->nos + desloc;
+            tabela[idx] = FILHO | (uint32_t)no;
+        }
+        tabela = &trie->nos[(size_t)(tabela[idx] & ~FILHO) * (1 << BITS_NO)];
+        inicio += passo;
+        passo = BITS_NO;
+    }
+    // Expande o prefixo sobre as entradas que ele cobre neste nível
+    int livres = inicio + passo - r->prefixo;
+    uint32_t base = extrair_bits(r->endereco, inicio, passo);
+    for (uint32_t i = 0; i < (1u << livres); i++)
+        tabela[base | i] = valor;
+    return 0;
+}
+
+// Copia os nós para memória alinhada em páginas de 2 MB: com um milhão de regras a trie
+// passa de 50 MB e, em páginas de 4 KB, quase toda busca pagaria uma falta de TLB
+static void fixar_em_paginas_grandes(TrieQoS *trie) {
+    const size_t pagina = 2 << 20;
+    size_t bytes = trie->num_nos * (1 << BITS_NO) * sizeof(uint32_t);
+    if (bytes < pagina) return;
+    bytes = (bytes + pagina - 1) & ~(pagina - 1);
+    uint32_t *novo = aligned_alloc(pagina, bytes);
+    if (!novo) return;
+    madvise(novo, bytes, MADV_HUGEPAGE);
+    memcpy(novo, trie->nos, trie->num_nos * (1 << BITS_NO) * sizeof(uint32_t));
+    free(trie->nos);
+    trie->nos = novo;
+    trie->cap_nos = bytes / ((1 << BITS_NO) * sizeof(uint32_t));
+}
+
+static int comparar_regras(const void *a, const void *b) {
+    const RegraQoS *x = a, *y = b;
+    if (x->prefixo != y->prefixo) return (int)x->prefixo - (int)y->prefixo;
+    return (x->ordem > y->ordem) - (x->ordem < y->ordem);
+}
+
+int qos_construir(TabelaQoS *t) {
+    liberar_trie(&t->v4);
+    liberar_trie(&t->v6);
+    free(t->taxas);
+    t->taxas = malloc((t->num_regras + 1) * sizeof(double));
+    t->v4.raiz = calloc(1 << BITS_RAIZ, sizeof(uint32_t));
+    t->v6.raiz = calloc(1 << BITS_RAIZ, sizeof(uint32_t));
+    if (!t->taxas || !t->v4.raiz || !t->v6.raiz) return -1;
+
+    // Ordena por prefixo; entre regras iguais, vale a última do arquivo
+    qsort(t->regras, t->num_regras, sizeof(RegraQoS), comparar_regras);
+    for (size_t i = 0; i < t->num_regras; i++) {
+        RegraQoS *r = &t->regras[i];
+        t->taxas[i] = r->taxa_kBps;
+        if (inserir(r->familia_v6 ? &t->v6 : &t->v4, r, (uint32_t)i + 1) != 0) return -1;
+    }
+    fixar_em_paginas_grandes(&t->v4);
+    fixar_em_paginas_grandes(&t->v6);
+    return 0;
+}
+
+static double resolver(const TabelaQoS *t, uint32_t valor) {
+    return valor ? t->taxas[valor - 1] : t->taxa_padrao;
+}
+
+double qos_buscar_v4(const TabelaQoS *t, uint32_t ip) {
+    uint32_t e = t->v4.raiz[ip >> 16];
+    if (e & FILHO) {
+        e = t->v4.nos[(size_t)(e & ~FILHO) * 256 + ((ip >> 8) & 0xff)];
+        if (e & FILHO) e = t->v4.nos[(size_t)(e & ~FILHO) * 256 + (ip & 0xff)];
+    }
+    return resolver(t, e);
+}
+
+double qos_buscar_v6(const TabelaQoS *t, const uint8_t ip[16]) {
+    uint32_t e = t->v6.raiz[((uint32_t)ip[0] << 8) | ip[1]];
+    for (int i = 2; i < 16 && (e & FILHO); i++)
+        e = t->v6.nos[(size_t)(e & ~FILHO) * 256 + ip[i]];
+    return resolver(t, e);
+}
+
+TabelaQoS *qos_carregar(const char *arquivo, double taxa_padrao) {
+    FILE *fp = fopen(arquivo, "r");
+    if (!fp) return NULL;
+    TabelaQoS *t = qos_criar(taxa_padrao);
+    if (!t) {
+        fclose(fp);
+        return NULL;
+    }
+
+    char linha[256];
+    int num_linha = 0;
+    while (fgets(linha, sizeof(linha), fp)) {
+        num_linha++;
+        char rede[INET6_ADDRSTRLEN + 8];
+        double taxa;
+        int lidos = linha[0] == '#' ? 0 : sscanf(linha, "%53s %lf", rede, &taxa);
+        if (lidos >= 1 && strlen(rede) == sizeof(rede) - 1) { // encheu a largura: o endereço foi cortado
+            fprintf(stderr, "QoS: linha %d ignorada (endereço longo demais)\n", num_linha);
+            continue;
+        }
+        if (lidos != 2) continue;
+        if (!isfinite(taxa) || taxa <= 0) { // uma taxa nula pararia as transferências do cliente
+            fprintf(stderr, "QoS: linha %d ignorada (taxa inválida)\n", num_linha);
+            continue;
+        }
+
+        char *barra = strchr(rede, '/');
+        int prefixo = -1;
+        if (barra) {
+            // Só dígitos até o fim: "10.0.0.0/" ou "/abc" não podem virar /0 (casaria todo endereço)
+            *barra = '\0';
+            char *fim;
+            long p = strtol(barra + 1, &fim, 10);
+            if (!isdigit((unsigned char)barra[1]) || *fim != '\0' || p > 128) {
+                fprintf(stderr, "QoS: linha %d ignorada (prefixo inválido)\n", num_linha);
+                continue;
+            }
+            prefixo = (int)p;
+        }
+        uint8_t end[16];
+        int familia = strchr(rede, ':') ? AF_INET6 : AF_INET;
+        if (inet_pton(familia, rede, end) != 1) {
+            fprintf(stderr, "QoS: linha %d ignorada (endereço inválido)\n", num_linha);
+            continue;
+        }
+        if (prefixo < 0) prefixo = (familia == AF_INET6) ? 128 : 32;
+        if (qos_adicionar(t, familia, end, prefixo, taxa) != 0)
+            fprintf(stderr, "QoS: linha %d ignorada (prefixo inválido)\n", num_linha);
+    }
+    fclose(fp);
+
+    if (qos_construir(t) != 0) {
+        qos_liberar(t);
+        return NULL;
+    }
+    return t;
+}
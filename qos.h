@@ -0,0 +1,30 @@
+// qos.h
+// Regras de QoS por sub-rede (CIDR) com casamento pelo prefixo mais longo
+// Trie multibit com leaf pushing: passo de 16 bits na raiz e de 8 bits abaixo.
+// IPv4 resolve em no máximo 3 acessos; IPv6 em no máximo 15. A tabela é imutável depois de montada
+
+#ifndef QOS_H
+#define QOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct TabelaQoS TabelaQoS;
+
+// Uma regra por linha: "endereço[/prefixo] taxa_kBps" (IPv4 ou IPv6; sem prefixo = host)
+// Retorna NULL se o arquivo não pode ser lido
+TabelaQoS *qos_carregar(const char *arquivo, double taxa_padrao);
+TabelaQoS *qos_criar(double taxa_padrao);
+// 'endereco' em ordem de rede (4 ou 16 bytes). Retorna 0 ou -1
+int qos_adicionar(TabelaQoS *t, int familia, const uint8_t *endereco, int prefixo, double taxa_kBps);
+// Monta a trie a partir das regras adicionadas. Retorna 0 ou -1
+int qos_construir(TabelaQoS *t);
+void qos_liberar(TabelaQoS *t);
+
+size_t qos_num_regras(const TabelaQoS *t);
+// 'ip' em ordem de host
+double qos_buscar_v4(const TabelaQoS *t, uint32_t ip);
+// O servidor só escuta em IPv4: as regras IPv6 são lidas e montadas, mas nenhum cliente as consulta
+double qos_buscar_v6(const TabelaQoS *t, const uint8_t ip[16]);
+
+#endif
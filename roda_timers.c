@@ -0,0 +1,143 @@
+// roda_timers.c
+// Roda de temporizadores hierárquica com resolução de 1 µs
+
+#include "roda_timers.h"
+
+static void lista_iniciar(Timer *s) {
+    s->prox = s->ant = s;
+}
+
+static int lista_vazia(const Timer *s) {
+    return s->prox == s;
+}
+
+static void lista_inserir(Timer *s, Timer *t) {
+    t->prox = s;
+    t->ant = s->ant;
+    s->ant->prox = t;
+    s->ant = t;
+}
+
+static void lista_retirar(Timer *t) {
+    t->ant->prox = t->prox;
+    t->prox->ant = t->ant;
+    t->prox = t->ant = NULL;
+}
+
+static uint64_t rotacionar(uint64_t v, int n) {
+    n &= 63;
+    return n ? (v >> n) | (v << (64 - n)) : v;
+}
+
+void roda_iniciar(RodaTimers *r, uint64_t agora_us) {
+    r->agora_us = agora_us;
+    for (int n = 0; n < RODA_NIVEIS; n++) {
+        r->ocupadas[n] = 0;
+        for (int p = 0; p < RODA_POSICOES; p++)
+            lista_iniciar(&r->posicoes[n][p]);
+    }
+    lista_iniciar(&r->expirados);
+}
+
+int roda_agendado(const Timer *t) {
+    return t->prox != NULL;
+}
+
+// O nível é dado pelo bit mais alto em que a expiração difere do relógio atual
+static void inserir(RodaTimers *r, Timer *t) {
+    if (t->expira_us <= r->agora_us) {
+        lista_inserir(&r->expirados, t);
+        return;
+    }
+    int nivel = (63 - __builtin_clzll(t->expira_us ^ r->agora_us)) / RODA_BITS;
+    int pos;
+    if (nivel < RODA_NIVEIS) {
+        pos = (int)((t->expira_us >> (nivel * RODA_BITS)) & (RODA_POSICOES - 1));
+    } else {
+        // Além do nível mais alto: usa a posição da expiração se ela estiver a menos de uma volta,
+        // senão estaciona na posição mais distante e é recolocado ao chegar lá
+        nivel = RODA_NIVEIS - 1;
+        int desloc = nivel * RODA_BITS;
+        uint64_t voltas = (t->expira_us >> desloc) - (r->agora_us >> desloc);
+        uint64_t alvo = (voltas < RODA_POSICOES) ? (t->expira_us >> desloc) : (r->agora_us >> desloc) - 1;
+        pos = (int)(alvo & (RODA_POSICOES - 1));
+    }
+    lista_inserir(&r->posicoes[nivel][pos], t);
+    r->ocupadas[nivel] |= UINT64_C(1) << pos;
+}
+
+void roda_cancelar(RodaTimers *r, Timer *t) {
+    if (!roda_agendado(t)) return;
+    Timer *prox = t->prox;
+    lista_retirar(t);
+    // Se a posição esvaziou, limpa o bit correspondente
+    if (lista_vazia(prox) && prox != &r->expirados) {
+        size_t idx = (size_t)(prox - &r->posicoes[0][0]);
+        if (idx < RODA_NIVEIS * RODA_POSICOES)
+            r->ocupadas[idx / RODA_POSICOES] &= ~(UINT64_C(1) << (idx % RODA_POSICOES));
+    }
+}
+
+void roda_agendar(RodaTimers *r, Timer *t, uint64_t expira_us) {
+    roda_cancelar(r, t);
+    t->expira_us = expira_us;
+    inserir(r, t);
+}
+
+void roda_avancar(RodaTimers *r, uint64_t agora_us) {
+    if (agora_us <= r->agora_us) return;
+
+    Timer pendentes;
+    lista_iniciar(&pendentes);
+
+    for (int n = 0; n < RODA_NIVEIS; n++) {
+        int desloc = n * RODA_BITS;
+        uint64_t passou = (agora_us >> desloc) - (r->agora_us >> desloc);
+        if (passou == 0) break; // níveis acima também não mudaram
+        int atual = (int)((r->agora_us >> desloc) & (RODA_POSICOES - 1));
+        uint64_t mascara = (passou >= RODA_POSICOES) ? ~UINT64_C(0)
+                         : rotacionar((UINT64_C(1) << passou) - 1, -(atual + 1));
+        uint64_t vencidas = r->ocupadas[n] & mascara;
+        while (vencidas) {
+            int pos = __builtin_ctzll(vencidas);
+            vencidas &= vencidas - 1;
+            Timer *s = &r->posicoes[n][pos];
+            while (!lista_vazia(s)) {
+                Timer *t = s->prox;
+                lista_retirar(t);
+                lista_inserir(&pendentes, t);
+            }
+            r->ocupadas[n] &= ~(UINT64_C(1) << pos);
+        }
+    }
+
+    r->agora_us = agora_us;
+    while (!lista_vazia(&pendentes)) {
+        Timer *t = pendentes.prox;
+        lista_retirar(t);
+        inserir(r, t);
+    }
+}
+
+Timer *roda_proximo_expirado(RodaTimers *r) {
+    if (lista_vazia(&r->expirados)) return NULL;
+    Timer *t = r->expirados.prox;
+    lista_retirar(t);
+    return t;
+}
+
+uint64_t roda_espera_us(const RodaTimers *r) {
+    if (!lista_vazia(&r->expirados)) return 0;
+    uint64_t espera = UINT64_MAX;
+    for (int n = 0; n < RODA_NIVEIS; n++) {
+        if (!r->ocupadas[n]) continue;
+        int desloc = n * RODA_BITS;
+        int atual = (int)((r->agora_us >> desloc) & (RODA_POSICOES - 1));
+        // Distância (1..64) até a próxima posição ocupada depois da atual
+        uint64_t d = (uint64_t)__builtin_ctzll(rotacionar(r->ocupadas[n], atual + 1)) + 1;
+        uint64_t inicio = ((r->agora_us >> desloc) + d) << desloc;
+        uint64_t e = inicio - r->agora_us;
+        if (e < espera) espera = e;
+    }
+    return espera;
+}
@@ -0,0 +1,42 @@
+// roda_timers.h
+// Roda de temporizadores hierárquica com resolução de 1 µs
+// 6 níveis de 64 posições (~19 h de alcance); mapas de bits acham a próxima posição ocupada em O(1)
+
+#ifndef RODA_TIMERS_H
+#define RODA_TIMERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RODA_NIVEIS 6
+#define RODA_BITS 6
+#define RODA_POSICOES (1 << RODA_BITS)
+
+// Nó intrusivo: fica dentro da estrutura dona (use container_of para recuperá-la)
+typedef struct Timer {
+    uint64_t expira_us;
+    struct Timer *prox, *ant; // NULL quando não agendado
+} Timer;
+
+typedef struct {
+    uint64_t agora_us;
+    uint64_t ocupadas[RODA_NIVEIS];
+    Timer posicoes[RODA_NIVEIS][RODA_POSICOES]; // sentinelas das listas
+    Timer expirados;
+} RodaTimers;
+
+#define container_of(ptr, tipo, campo) ((tipo *)((char *)(ptr) - offsetof(tipo, campo)))
+
+void roda_iniciar(RodaTimers *r, uint64_t agora_us);
+// (Re)agenda o timer; expirações no passado ficam prontas na próxima roda_proximo_expirado
+void roda_agendar(RodaTimers *r, Timer *t, uint64_t expira_us);
+void roda_cancelar(RodaTimers *r, Timer *t);
+int roda_agendado(const Timer *t);
+// Avança o relógio da roda, movendo os timers vencidos para a lista de expirados
+void roda_avancar(RodaTimers *r, uint64_t agora_us);
+// Retira um timer expirado (NULL se não há)
+Timer *roda_proximo_expirado(RodaTimers *r);
+// Microssegundos até a roda precisar ser avançada (UINT64_MAX se vazia)
+uint64_t roda_espera_us(const RodaTimers *r);
+
+#endif
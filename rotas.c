@@ -0,0 +1,262 @@
+// rotas.c
+// Tabela de rotas com hash perfeito mínimo e fallback por prefixo
+
+#define _GNU_SOURCE
+#include "rotas.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define LAMBDA 4                 // chaves por balde em média
+#define MAX_TENTATIVAS_BALDE 65536
+#define MAX_SAIS 16
+
+static uint64_t hash_caminho(const char *s, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Finalizador do splitmix64: espalha bem os bits de h combinado com o deslocamento
+static uint64_t misturar(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static size_t balde_de(const TabelaRotas *t, uint64_t h) {
+    return (size_t)(misturar(h ^ t->sal) % t->num_baldes);
+}
+
+static size_t posicao_de(const TabelaRotas *t, uint64_t h, uint32_t desloc) {
+    return (size_t)(misturar(h + t->sal + (uint64_t)desloc * 0x632be59bd9b4e019ULL) % t->num_entradas);
+}
+
+void rotas_iniciar(TabelaRotas *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+static int anexar(EntradaRota **v, size_t *n, size_t *cap, const char *caminho, size_t len, Asset *asset) {
+    if (*n == *cap) {
+        size_t nova_cap = *cap ? *cap * 2 : 64;
+        EntradaRota *novo = realloc(*v, nova_cap * sizeof(EntradaRota));
+        if (!novo) return -1;
+        *v = novo;
+        *cap = nova_cap;
+    }
+    EntradaRota *e = &(*v)[(*n)++];
+    e->caminho = strndup(caminho, len);
+    e->len = (uint32_t)len;
+    e->hash = hash_caminho(caminho, len);
+    e->asset = asset;
+    return e->caminho ? 0 : -1;
+}
+
+int rotas_adicionar(TabelaRotas *t, const char *caminho, Asset *asset) {
+    size_t len = strlen(caminho);
+    if (len >= 2 && strcmp(caminho + len - 2, "/*") == 0)
+        return anexar(&t->prefixos, &t->num_prefixos, &t->cap_prefixos, caminho, len - 1, asset);
+    return anexar(&t->entradas, &t->num_entradas, &t->cap_entradas, caminho, len, asset);
+}
+
+// Adiciona cada arquivo regular de 'dir' (recursivo) sob o prefixo de URL 'base'
+static int adicionar_diretorio(TabelaRotas *t, const char *base, const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    int total = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue; // ocultos, "." e ".."
+        char arquivo[CACHE_MAX_NOME], url[CACHE_MAX_NOME];
+        const char *sep = (base[0] && base[strlen(base) - 1] == '/') ? "" : "/";
+        if ((size_t)snprintf(arquivo, sizeof(arquivo), "%s/%s", dir, ent->d_name) >= sizeof(arquivo) ||
+            (size_t)snprintf(url, sizeof(url), "%s%s%s", base, sep, ent->d_name) >= sizeof(url))
+            continue; // caminho longo demais
+        struct stat st;
+        if (stat(arquivo, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            int n = adicionar_diretorio(t, url, arquivo);
+            if (n > 0) total += n;
+        } else if (S_ISREG(st.st_mode)) {
+            if (rotas_adicionar(t, url, cache_carregar(arquivo)) == 0) total++;
+        }
+    }
+    closedir(d);
+    return total;
+}
+
+int rotas_carregar_manifesto(TabelaRotas *t, const char *manifesto) {
+    FILE *fp = fopen(manifesto, "r");
+    if (!fp) return -1;
+    int total = 0;
+    char linha[2 * CACHE_MAX_NOME];
+    while (fgets(linha, sizeof(linha), fp)) {
+        char caminho[CACHE_MAX_NOME], arquivo[CACHE_MAX_NOME];
+        if (linha[0] == '#' || sscanf(linha, "%255s %255s", caminho, arquivo) != 2) continue;
+        struct stat st;
+        if (stat(arquivo, &st) == 0 && S_ISDIR(st.st_mode)) {
+            int n = adicionar_diretorio(t, caminho, arquivo);
+            if (n > 0) total += n;
+        } else if (rotas_adicionar(t, caminho, cache_carregar(arquivo)) == 0) {
+            total++;
+        }
+    }
+    fclose(fp);
+    return total;
+}
+
+int rotas_carregar_docroot(TabelaRotas *t, const char *docroot) {
+    return adicionar_diretorio(t, "", docroot);
+}
+
+static int comparar_entradas(const void *a, const void *b) {
+    const EntradaRota *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return strcmp(x->caminho, y->caminho);
+}
+
+static int comparar_prefixos(const void *a, const void *b) {
+    const EntradaRota *x = a, *y = b;
+    return (int)y->len - (int)x->len;
+}
+
+typedef struct {
+    size_t balde;
+    size_t inicio, qtd; // chaves do balde em 'ordem'
+} InfoBalde;
+
+static int comparar_baldes(const void *a, const void *b) {
+    const InfoBalde *x = a, *y = b;
+    return (x->qtd < y->qtd) - (x->qtd > y->qtd); // maiores primeiro
+}
+
+// Tenta montar o hash com o sal atual; 'saida' recebe as entradas nas posições finais
+static int tentar_construir(TabelaRotas *t, EntradaRota *saida, char *ocupada) {
+    size_t n = t->num_entradas;
+    InfoBalde *baldes = calloc(t->num_baldes, sizeof(InfoBalde));
+    size_t *posicoes = malloc(n * sizeof(size_t));
+    EntradaRota *ordem = malloc(n * sizeof(EntradaRota));
+    if (!baldes || !posicoes || !ordem) {
+        free(baldes);
+        free(posicoes);
+        free(ordem);
+        return -1;
+    }
+
+    // Agrupa as chaves por balde (ordenação por contagem)
+    for (size_t b = 0; b < t->num_baldes; b++) baldes[b].balde = b;
+    for (size_t i = 0; i < n; i++) baldes[balde_de(t, t->entradas[i].hash)].qtd++;
+    size_t acum = 0;
+    for (size_t b = 0; b < t->num_baldes; b++) {
+        baldes[b].inicio = acum;
+        acum += baldes[b].qtd;
+        baldes[b].qtd = 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        InfoBalde *ib = &baldes[balde_de(t, t->entradas[i].hash)];
+        ordem[ib->inicio + ib->qtd++] = t->entradas[i];
+    }
+    qsort(baldes, t->num_baldes, sizeof(InfoBalde), comparar_baldes);
+
+    memset(ocupada, 0, n);
+    int ok = 0;
+    for (size_t b = 0; b < t->num_baldes && baldes[b].qtd > 0; b++) {
+        InfoBalde *ib = &baldes[b];
+        uint32_t d;
+        for (d = 0; d < MAX_TENTATIVAS_BALDE; d++) {
+            size_t k;
+            for (k = 0; k < ib->qtd; k++) {
+                size_t pos = posicao_de(t, ordem[ib->inicio + k].hash, d);
+                if (ocupada[pos]) break;
+                // Colisão dentro do próprio balde
+                size_t j;
+                for (j = 0; j < k && posicoes[j] != pos; j++);
+                if (j < k) break;
+                posicoes[k] = pos;
+            }
+            if (k == ib->qtd) break;
+        }
+        if (d == MAX_TENTATIVAS_BALDE) {
+            ok = -1;
+            break;
+        }
+        t->deslocamentos[ib->balde] = d;
+        for (size_t k = 0; k < ib->qtd; k++) {
+            ocupada[posicoes[k]] = 1;
+            saida[posicoes[k]] = ordem[ib->inicio + k];
+        }
+    }
+    free(baldes);
+    free(posicoes);
+    free(ordem);
+    return ok;
+}
+
+int rotas_construir(TabelaRotas *t) {
+    qsort(t->prefixos, t->num_prefixos, sizeof(EntradaRota), comparar_prefixos);
+    if (t->num_entradas == 0) return 0;
+
+    // Rotas repetidas: vale a primeira
+    qsort(t->entradas, t->num_entradas, sizeof(EntradaRota), comparar_entradas);
+    size_t n = 0;
+    for (size_t i = 0; i < t->num_entradas; i++) {
+        if (n > 0 && t->entradas[n - 1].hash == t->entradas[i].hash &&
+            strcmp(t->entradas[n - 1].caminho, t->entradas[i].caminho) == 0) {
+            fprintf(stderr, "Aviso: rota repetida %s ignorada\n", t->entradas[i].caminho);
+            free(t->entradas[i].caminho);
+            continue;
+        }
+        t->entradas[n++] = t->entradas[i];
+    }
+    t->num_entradas = n;
+
+    t->num_baldes = (n + LAMBDA - 1) / LAMBDA;
+    t->deslocamentos = calloc(t->num_baldes, sizeof(uint32_t));
+    EntradaRota *saida = malloc(n * sizeof(EntradaRota));
+    char *ocupada = malloc(n);
+    if (!t->deslocamentos || !saida || !ocupada) {
+        free(saida);
+        free(ocupada);
+        return -1;
+    }
+
+    int ok = -1;
+    for (uint64_t s = 0; s < MAX_SAIS && ok != 0; s++) {
+        t->sal = misturar(s);
+        ok = tentar_construir(t, saida, ocupada);
+    }
+    free(ocupada);
+    if (ok != 0) {
+        free(saida);
+        return -1;
+    }
+    free(t->entradas);
+    t->entradas = saida;
+    t->cap_entradas = n;
+    return 0;
+}
+
+Asset *rotas_buscar(const TabelaRotas *t, const char *caminho, size_t len) {
+    const char *q = memchr(caminho, '?', len);
+    if (q) len = (size_t)(q - caminho);
+
+    if (t->num_entradas > 0) {
+        uint64_t h = hash_caminho(caminho, len);
+        const EntradaRota *e = &t->entradas[posicao_de(t, h, t->deslocamentos[balde_de(t, h)])];
+        if (e->hash == h && e->len == len && memcmp(e->caminho, caminho, len) == 0)
+            return e->asset;
+    }
+    for (size_t i = 0; i < t->num_prefixos; i++) {
+        const EntradaRota *e = &t->prefixos[i];
+        if (len >= e->len && memcmp(caminho, e->caminho, e->len) == 0)
+            return e->asset;
+    }
+    return NULL;
+}
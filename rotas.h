@@ -0,0 +1,44 @@
+// rotas.h
+// Tabela de rotas: caminho da URL -> asset do cache
+// Rotas exatas ficam num hash perfeito mínimo (hash-e-deslocamento, CHD): uma sondagem por busca,
+// qualquer que seja o número de rotas. Rotas de prefixo ("/galeria/*") são o fallback
+
+#ifndef ROTAS_H
+#define ROTAS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache_arquivos.h"
+
+typedef struct {
+    char *caminho;
+    uint32_t len;
+    uint64_t hash;
+    Asset *asset;
+} EntradaRota;
+
+typedef struct {
+    EntradaRota *entradas;   // exatas; após construir, indexadas pela posição do hash perfeito
+    size_t num_entradas, cap_entradas;
+    uint32_t *deslocamentos; // um por balde
+    size_t num_baldes;
+    uint64_t sal;
+    EntradaRota *prefixos;   // ordenados do mais longo para o mais curto
+    size_t num_prefixos, cap_prefixos;
+} TabelaRotas;
+
+void rotas_iniciar(TabelaRotas *t);
+// Caminho terminado em "/*" vira rota de prefixo
+int rotas_adicionar(TabelaRotas *t, const char *caminho, Asset *asset);
+// Manifesto: uma rota por linha, "caminho arquivo" ('#' comenta). Se 'arquivo' é um diretório,
+// cada arquivo dentro dele vira "caminho/nome". Retorna o número de rotas ou -1
+int rotas_carregar_manifesto(TabelaRotas *t, const char *manifesto);
+// Cada arquivo regular sob 'docroot' vira "/caminho/relativo". Retorna o número de rotas ou -1
+int rotas_carregar_docroot(TabelaRotas *t, const char *docroot);
+// Monta o hash perfeito; chamar depois de adicionar todas as rotas. Retorna 0 ou -1
+int rotas_construir(TabelaRotas *t);
+// Busca (ignora a query string). NULL se nenhuma rota casa
+Asset *rotas_buscar(const TabelaRotas *t, const char *caminho, size_t len);
+
+#endif
@@ -1,340 +1,1897 @@
 // servidor_final_completo.c
-// Servidor HTTP multithread com RTT, banda por cliente e limite de vazão
+// Servidor HTTP com RTT, banda por cliente e limite de vazão
+// Motor de eventos epoll (edge-triggered): poucas threads atendem milhares de conexões
+// Com -u, o mesmo ciclo roda sobre io_uring (aceite, leitura e envio sem uma syscall por operação)
 // Bianca Durgante - Projeto Redes UNIPAMPA
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <pthread.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <libgen.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sched.h>
+#include <linux/filter.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 
+#include "envio.h"
+#include "balde_fichas.h"
+#include "roda_timers.h"
+#include "parser_http.h"
+#include "cache_arquivos.h"
+#include "rotas.h"
+#include "qos.h"
+#include "tabela_clientes.h"
+#include "orcamento_banda.h"
+#include "historico.h"
+#include "metricas.h"
+#include "fila_admissao.h"
+#include "alocador_banda.h"
+#include "faixas_http.h"
+#include "anel_io.h"
+#include "arena.h"
+
 #define PORTA_PADRAO 5000
-#define MAX_CLIENTES 100
-#define MAX_REQUISICOES 1000
+#define MAX_CLIENTES (1 << 20) // clientes com estatísticas guardadas (os menos recentes são descartados)
+#define CLIENTE_OCIOSO_S 600   // estatísticas de um cliente sem requisições expiram
 #define BUF_SIZE 4096
 #define MAX_PATH 256
 #define TX_PADRAO 1000 // kB/s para IPs não listados
+#define MAX_EVENTOS 256 // eventos tratados por chamada de epoll_wait
+#define RAJADA_PADRAO_KB 64 // capacidade do balde de fichas de cada conexão
+#define MAX_REQ_CONEXAO 100 // requisições atendidas por conexão persistente
+#define OCIOSO_PADRAO_S 5   // tempo máximo de uma conexão persistente sem requisição
+#define CABECALHO_PADRAO_S 10 // tempo máximo para uma requisição chegar inteira
+#define ESCRITA_PADRAO_S 30 // tempo máximo de um envio parado com o socket cheio
+#define ESPERA_PADRAO_MS 1000 // tempo máximo na fila de admissão antes do 503
+#define FILA_MAX 4096         // requisições esperando banda ao mesmo tempo
+#define JANELA_DEMANDA_US 500000 // janela em que se mede a taxa que cada transferência alcança
+#define ANEL_ENTRADAS 4096 // SQEs do anel io_uring de cada thread
+#define ANEL_BUFFERS 256   // buffers de leitura fornecidos ao kernel por thread (potência de 2)
+#define CONEXOES_POR_BLOCO 256 // conexões em cada bloco do slab de uma thread
+#define TRECHO_JUNTO_MAX (16 * 1024) // corpo copiado no mesmo sendmsg do cabeçalho (o resto vai por sendfile)
+#define METRICAS_CAB_MAX 160 // espaço do cabeçalho antes do corpo de /metrics
 
-typedef struct {
-    char ip[INET_ADDRSTRLEN];
-    double taxa_kBps;
-} QoS_IP;
+// Operação de uma conclusão do io_uring, nos 3 bits baixos do user_data (o resto é o ponteiro
+// da conexão ou do laço). user_data 0: conclusão sem interesse
+typedef enum {
+    OP_ACEITAR,  // accept multishot do socket de escuta (laço)
+    OP_AVISO,    // poll multishot do eventfd de concessões (laço)
+    OP_PRAZO,    // timeout absoluto no próximo prazo da roda (laço)
+    OP_LER,      // recv com buffer fornecido
+    OP_ENVIAR,   // send do cabeçalho ou de uma parte do multipart
+    OP_ARQUIVO,  // splice arquivo -> pipe (elo 1)
+    OP_ESPERA,   // poll POLLOUT do socket (elo 2)
+    OP_SOCKET    // splice pipe -> socket (elo 3)
+} OperacaoAnel;
+#define OP_MASCARA 7
 
-typedef struct {
-    char ip[INET_ADDRSTRLEN];
-    double last_rtt;
-    double last_bandwidth;
-    struct timeval last_request_time;
-    int requisicoes;
-    int ativo;
-    pthread_t thread_id;
-} ClienteInfo;
+// Ciclo de vida de uma conexão: aceita -> lendo -> (admissão [-> aguardando]) -> enviando <-> pausada -> fechada
+// Em conexões persistentes, ao fim do envio a conexão volta a "lendo" para a próxima requisição
+typedef enum {
+    CONEXAO_LENDO,      // recebendo a requisição (ou ociosa entre requisições)
+    CONEXAO_AGUARDANDO, // na fila de admissão, esperando banda
+    CONEXAO_ENVIANDO,   // transmitindo cabeçalho e arquivo
+    CONEXAO_PAUSADA     // aguardando fichas no balde (controle de banda)
+} EstadoConexao;
+
+struct LacoEventos;
 
 typedef struct {
-    int id_requisicao;
+    struct LacoEventos *laco; // thread dona da conexão
+    int sock;
+    EstadoConexao estado;
     char ip[INET_ADDRSTRLEN];
-    double rtt;
-    double bandwidth;
-    pthread_t thread_id;
-    int rejeitada; // 1 se rejeitada
-} RequisicaoInfo;
+    uint32_t ip_bin;        // endereço em ordem de host (chave das tabelas de QoS e de clientes)
+
+    char *req;              // BUF_SIZE bytes recebidos (pode conter requisições em pipeline);
+                            // da arena da thread, só enquanto há bytes a examinar
+    size_t req_len;
+    size_t req_usado;       // tamanho da requisição em atendimento
+    ParserHttp parser;      // estado do parser sobre 'req' (retomado a cada leitura)
+    int fim_entrada;        // cliente encerrou o envio (EOF)
+    int cabeca;             // requisição HEAD: só o cabeçalho da resposta
+    int manter_viva;        // a resposta atual mantém a conexão aberta
+    int atendidas;          // requisições já atendidas nesta conexão
+
+    char resposta[320];     // resposta de erro completa
+    char *resp_dinamica;    // resposta gerada na hora (/metrics, 206); devolvida à arena ao concluir
+    size_t resp_dinamica_tam;
+    const char *resp_ptr;   // cabeçalho a enviar: 'resposta', 'resp_dinamica' ou o pronto do cache
+    size_t resp_len, resp_enviado;
+    int status;             // status HTTP da resposta atual
+    uint64_t chegada_us;    // requisição completa: base da latência e do tempo até o primeiro byte
+
+    VersaoAsset *versao;    // arquivo em envio (referência do cache); NULL sem corpo
+    const Representacao *rep; // codificação escolhida da versão (identidade, gzip ou brotli)
+    EnvioArquivo envio;     // corpo enviado por sendfile/splice
+    RespostaFaixas faixas;  // trechos do arquivo a enviar (o arquivo inteiro é uma faixa só)
+    int faixa_atual;
+    size_t parte_enviado;   // bytes já enviados do cabeçalho da parte atual (multipart)
+    int tampada;            // TCP_CORK ligado (multipart em andamento)
+    struct iovec iov[2];    // cabeçalho + começo do corpo no sendmsg do io_uring (vivos até a conclusão)
+    struct msghdr msg;
+    off_t corpo_len;        // tamanho do corpo da resposta atual
+    BaldeFichas balde;      // ritmo do envio na taxa do cliente
+
+    double taxa_kBps;       // taxa de QoS do cliente: piso reservado e peso na divisão da sobra
+    double ritmo_kBps;      // taxa atual do balde de fichas (piso + parte da sobra)
+    FatiaBanda fatia;       // participação no alocador enquanto transfere
+    uint64_t geracao_alocacao;
+    uint64_t janela_us;     // início da janela de medição da taxa alcançada
+    size_t janela_bytes;
+    int janela_cheia;       // o socket encheu durante a janela
+    int64_t reserva_Bps;    // reservada no orçamento enquanto reservou == 1
+    int reservou;
+    uint64_t geracao_qos;   // geração das regras de QoS que definiram a taxa
+    struct timeval inicio;
+
+    EsperaAdmissao espera;  // nó na fila de admissão (estado aguardando)
+    int descartada;         // fechada com a concessão da fila já a caminho do laço
+
+    int ops_anel;           // operações io_uring em voo (a memória só é liberada quando zera)
+    int fechada;            // fechada com operações em voo
+    size_t anel_pedido;     // bytes pedidos no último splice para o socket
 
-ClienteInfo clientes[MAX_CLIENTES];
-pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
-QoS_IP qos_ips[100];
-int qos_count = 0;
+    Timer timer;            // fim da pausa, prazo de leitura (lendo), de escrita (enviando) ou da espera (aguardando)
+    int prazo_cabecalho;    // o prazo de leitura em curso é o do cabeçalho (não o de ociosidade)
+} Conexao;
 
-RequisicaoInfo requisicoes[MAX_REQUISICOES];
-int requisicao_count = 0;
+// Cada thread de eventos tem seu epoll e sua roda de temporizadores
+typedef struct LacoEventos {
+    int epfd;
+    int server_fd;              // compartilhado, ou o socket de escuta próprio da thread (-p)
+    pthread_t thread;
+    TabelaClientes *clientes;   // estatísticas dos clientes atendidos aqui (a tabela global sem -p)
+    Slab conexoes;              // memória das conexões desta thread
+    ArenaBuffers buffers;       // requisições e respostas geradas das conexões desta thread
+    RodaTimers roda;
+    atomic_uint_fast64_t epoca; // geração de QoS vista ao acordar; 0 enquanto dorme no epoll
+    int aviso_fd;               // eventfd acordado quando a fila concede banda a uma conexão daqui
+    _Atomic(EsperaAdmissao *) concedidas; // pilha de concessões (várias threads empilham, o laço esvazia)
+    AnelIO anel;                // motor io_uring (-u)
+    uint64_t prazo_armado;      // prazo do timeout em voo no anel (UINT64_MAX: nenhum)
+    struct __kernel_timespec prazo_ts;
+} LacoEventos;
+
+TabelaClientes clientes;
+// Regras de QoS: cada recarga publica uma tabela nova inteira e troca o ponteiro.
+// A antiga só é liberada quando todos os laços passaram por um estado quiescente
+_Atomic(TabelaQoS *) qos;
+atomic_uint_fast64_t geracao_qos = 1;
+const char *arquivo_qos;
+int atualizar_em_andamento = 0; // novas taxas valem também para transferências em curso
+
+LacoEventos *lacos;
+int num_lacos;
+
+TabelaRotas rotas; // montada ao iniciar, somente leitura depois
 
 double vazao_maxima = 1000; // kB/s
-double vazao_atual = 0;
+OrcamentoBanda orcamento; // soma das taxas reservadas (sem trava)
+FilaAdmissao fila;        // requisições esperando banda, atendidas por WFQ
+AlocadorBanda alocador;   // divide a vazão entre as transferências ativas
+int redistribuir = 1;     // 0: cada transferência fica só com a sua taxa de QoS
+uint64_t espera_max_us = ESPERA_PADRAO_MS * 1000ULL;
+size_t rajada_bytes = RAJADA_PADRAO_KB * 1024;
+int max_req_conexao = MAX_REQ_CONEXAO;
+uint64_t ocioso_us = OCIOSO_PADRAO_S * 1000000ULL;
+uint64_t cabecalho_us = CABECALHO_PADRAO_S * 1000000ULL;
+uint64_t escrita_us = ESCRITA_PADRAO_S * 1000000ULL;
+int usar_anel = 0; // motor io_uring; volta a 0 se o kernel não o suporta
+int buf_envio = 0, buf_recepcao = 0; // SO_SNDBUF / SO_RCVBUF das conexões (0 = padrão do kernel)
+int escuta_por_nucleo = 0; // um socket SO_REUSEPORT por thread, cada thread presa a um núcleo
 
 // Funções
-void *atender_cliente(void *arg);
+void *laco_eventos(void *arg);
+void tratar_expirados(LacoEventos *laco);
+void armar_prazo_leitura(LacoEventos *laco, Conexao *c);
+void armar_prazo_escrita(LacoEventos *laco, Conexao *c);
+void aceitar_conexoes(LacoEventos *laco);
+Conexao *nova_conexao(LacoEventos *laco, int sock, const struct sockaddr_in *addr);
+void ler_requisicao(LacoEventos *laco, Conexao *c);
+void analisar_requisicao(LacoEventos *laco, Conexao *c);
+int obter_req(LacoEventos *laco, Conexao *c);
+void soltar_req(LacoEventos *laco, Conexao *c);
+void soltar_buffers(LacoEventos *laco, Conexao *c);
+char *obter_resposta(Conexao *c, size_t tam);
+void processar_requisicao(LacoEventos *laco, Conexao *c);
+int requisicao_seguinte_completa(const Conexao *c);
+const Representacao *escolher_representacao(const Conexao *c);
+int preparar_corpo(Conexao *c);
+int if_range_vale(const Conexao *c);
+int nao_modificado(const Conexao *c);
+void iniciar_envio(LacoEventos *laco, Conexao *c);
+void recusar_admissao(LacoEventos *laco, Conexao *c);
+void conceder_admissao(EsperaAdmissao *e);
+void receber_concessoes(LacoEventos *laco);
+void enviar_resposta(LacoEventos *laco, Conexao *c);
+int enviar_parte(LacoEventos *laco, Conexao *c);
+int aguardar_fichas(LacoEventos *laco, Conexao *c, size_t *fichas);
+int juntar_cabecalho(const Conexao *c);
+size_t contar_cabecalho(Conexao *c, size_t n);
+ssize_t enviar_junto(Conexao *c, size_t fichas);
+void tampar(Conexao *c, int ligar);
+int proxima_faixa(Conexao *c);
+void finalizar_requisicao(LacoEventos *laco, Conexao *c);
+void concluir_resposta(LacoEventos *laco, Conexao *c);
+void liberar_reserva(Conexao *c);
+void fechar_conexao(LacoEventos *laco, Conexao *c);
+void responder_erro(Conexao *c, const char *status);
+void responder_metricas(Conexao *c);
+const char *texto_status(int status);
+void registrar_requisicao(Conexao *c, double rtt, double banda, int rejeitada);
+uint64_t agora_us(void);
 void *monitorar_clientes(void *arg);
-void enviar_arquivo(int sock, const char *nome_arquivo, double taxa_kBps);
-int buscar_cliente(const char *ip);
-int registrar_cliente(const char *ip);
+size_t total_clientes(void);
+int abrir_escuta(int porta, int backlog, int reuseport);
+void direcionar_por_cpu(int server_fd);
+void iniciar_thread(LacoEventos *laco, int indice, void *(*funcao)(void *));
 double calcular_tempo(struct timeval inicio, struct timeval fim);
-double buscar_taxa_ip(const char *ip);
+double buscar_taxa_ip(uint32_t ip);
 void carregar_qos(const char *arquivo_qos);
-long tamanho_arquivo_kb(const char *nome_arquivo);
+void recarregar_qos(void);
+void esperar_quiescencia(uint64_t geracao);
+void *vigiar_qos(void *arg);
+void atualizar_taxa(Conexao *c);
+void acompanhar_alocacao(Conexao *c);
+int iniciar_aneis(void);
+void *laco_anel(void *arg);
+void tratar_conclusao(LacoEventos *laco, uint64_t dado, int res, uint32_t flags);
+void anel_armar_aceite(LacoEventos *laco);
+void anel_armar_aviso(LacoEventos *laco);
+void anel_armar_prazo(LacoEventos *laco);
+void anel_receber(LacoEventos *laco, Conexao *c);
+void anel_enviar(LacoEventos *laco, Conexao *c, const char *dados, size_t len);
+void anel_enviar_junto(LacoEventos *laco, Conexao *c, size_t fichas);
+void anel_transmitir(LacoEventos *laco, Conexao *c, size_t max);
+void anel_enviar_resposta(LacoEventos *laco, Conexao *c);
 
 int main(int argc, char *argv[]) {
-    int server_fd;
-    struct sockaddr_in address;
+    int server_fd = -1;
     pthread_t thread_monitor;
 
+    // -t N: número de threads de eventos (padrão: uma por núcleo)
+    // -b kB: rajada máxima do balde de fichas de cada conexão
+    // -k N: requisições por conexão persistente; -i s: tempo ocioso antes de fechar
+    // -h s: prazo para a requisição chegar inteira; -w s: prazo de um envio sem progresso
+    // -r arquivo: manifesto de rotas; -d dir: publica todos os arquivos do diretório
+    // -c N: máximo de clientes com estatísticas guardadas
+    // -e ms: espera máxima na fila de admissão quando falta banda (0 = 503 imediato)
+    // -v s: validade das cópias nos clientes (Cache-Control max-age)
+    // -s: taxas estáticas (sem redistribuir a vazão ociosa entre as transferências ativas)
+    // -l base: histórico de requisições em <base>.bin e <base>.jsonl
+    // -a: ao recarregar o QoS (SIGHUP ou arquivo alterado), ajusta também as transferências em curso
+    // -u: motor io_uring (cai para o epoll se o kernel não tiver suporte)
+    // -p: um socket de escuta SO_REUSEPORT por thread, threads presas aos núcleos e estatísticas
+    //     de clientes locais a cada thread; -f N: fila de conexões pendentes de cada listen
+    // -o kB / -n kB: buffers de envio (SO_SNDBUF) e de recepção (SO_RCVBUF) das conexões
+    num_lacos = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *manifesto = "rotas.txt", *docroot = NULL;
+    size_t max_clientes = MAX_CLIENTES;
+    const char *historico_base = "requisicoes";
+    int backlog = SOMAXCONN;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:b:k:i:h:w:r:d:ac:l:e:sv:upf:o:n:")) != -1) {
+        switch (opt) {
+        case 't': num_lacos = atoi(optarg); break;
+        case 'b': rajada_bytes = (size_t)(atof(optarg) * 1024); break;
+        case 'k': max_req_conexao = atoi(optarg); break;
+        case 'i': ocioso_us = (uint64_t)(atof(optarg) * 1e6); break;
+        case 'h': cabecalho_us = (uint64_t)(atof(optarg) * 1e6); break;
+        case 'w': escrita_us = (uint64_t)(atof(optarg) * 1e6); break;
+        case 'r': manifesto = optarg; break;
+        case 'd': docroot = optarg; break;
+        case 'a': atualizar_em_andamento = 1; break;
+        case 'c': max_clientes = (size_t)atol(optarg); break;
+        case 'l': historico_base = optarg; break;
+        case 's': redistribuir = 0; break;
+        case 'v': cache_definir_validade(atoi(optarg)); break;
+        case 'e': espera_max_us = (uint64_t)(atof(optarg) * 1000); break;
+        case 'u': usar_anel = 1; break;
+        case 'p': escuta_por_nucleo = 1; break;
+        case 'f': backlog = atoi(optarg); break;
+        case 'o': buf_envio = (int)(atof(optarg) * 1024); break;
+        case 'n': buf_recepcao = (int)(atof(optarg) * 1024); break;
+        default:
+            fprintf(stderr, "Uso: %s [-t threads] [-b rajada_kB] [-k max_req] [-i ocioso_s] [-h cabecalho_s] [-w escrita_s] "
+                    "[-r manifesto | -d docroot] [-a] [-c max_clientes] [-l historico] [-e espera_ms] [-s] [-v validade_s] [-u] [-p] [-f backlog] [-o sndbuf_kB] [-n rcvbuf_kB] [porta] [arquivo_qos] [vazao_kBps]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (num_lacos < 1) num_lacos = 1;
+    if (rajada_bytes < 4096) rajada_bytes = 4096;
+    if (max_req_conexao < 1) max_req_conexao = 1;
+    if (backlog < 1) backlog = SOMAXCONN;
+    argc -= optind - 1;
+    argv += optind - 1;
+
     int porta = (argc > 1) ? atoi(argv[1]) : PORTA_PADRAO;
-    const char *arquivo_qos = (argc > 2) ? argv[2] : "ips.txt";
+    arquivo_qos = (argc > 2) ? argv[2] : "ips.txt";
     vazao_maxima = (argc > 3) ? atof(argv[3]) : 1000;
 
-    for (int i = 0; i < MAX_CLIENTES; i++) clientes[i].ativo = 0;
+    // Com -p cada thread guarda os seus clientes; a capacidade é dividida entre elas
+    lacos = calloc(num_lacos, sizeof(LacoEventos));
+    for (int i = 0; i < num_lacos; i++) {
+        lacos[i].clientes = escuta_por_nucleo ? malloc(sizeof(TabelaClientes)) : &clientes;
+        if (!lacos[i].clientes || (escuta_por_nucleo && clientes_iniciar(lacos[i].clientes, max_clientes / num_lacos) != 0)) {
+            perror("Erro ao criar tabela de clientes");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (!escuta_por_nucleo && clientes_iniciar(&clientes, max_clientes) != 0) {
+        perror("Erro ao criar tabela de clientes");
+        exit(EXIT_FAILURE);
+    }
+    if (historico_iniciar(historico_base) != 0) {
+        perror("Erro ao abrir o histórico de requisições");
+        exit(EXIT_FAILURE);
+    }
+
+    // SIGHUP bloqueado em todas as threads: só vigiar_qos o recebe, via signalfd
+    sigset_t sinais;
+    sigemptyset(&sinais);
+    sigaddset(&sinais, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &sinais, NULL);
 
     carregar_qos(arquivo_qos);
 
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+    // Rotas e arquivos lidos uma vez; alterações no disco são recarregadas em segundo plano
+    rotas_iniciar(&rotas);
+    int num_rotas = docroot ? rotas_carregar_docroot(&rotas, docroot)
+                            : rotas_carregar_manifesto(&rotas, manifesto);
+    if (num_rotas < 0) {
+        perror(docroot ? docroot : manifesto);
+        exit(EXIT_FAILURE);
+    }
+    if (rotas_construir(&rotas) != 0) {
+        fprintf(stderr, "Erro ao montar a tabela de rotas\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("Rotas carregadas: %d\n", num_rotas);
+    cache_vigiar();
+
+    // Escritas em sockets fechados pelo cliente viram EPIPE, não sinal
+    signal(SIGPIPE, SIG_IGN);
+
+    // Dezenas de milhares de conexões precisam de mais descritores que o padrão
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    // Sem -p, um socket de escuta para todas as threads; com -p, um por thread no mesmo endereço
+    if (escuta_por_nucleo) {
+        for (int i = 0; i < num_lacos; i++)
+            lacos[i].server_fd = abrir_escuta(porta, backlog, 1);
+        direcionar_por_cpu(lacos[0].server_fd);
+    } else {
+        server_fd = abrir_escuta(porta, backlog, 0);
+        for (int i = 0; i < num_lacos; i++)
+            lacos[i].server_fd = server_fd;
+    }
+
+    printf("Servidor iniciado na porta %d...\n", porta);
+    orcamento_iniciar(&orcamento, vazao_maxima);
+    alocador_iniciar(&alocador, vazao_maxima);
+    if (fila_iniciar(&fila, &orcamento, FILA_MAX, conceder_admissao) != 0) {
+        perror("Erro ao criar fila de admissão");
+        exit(EXIT_FAILURE);
+    }
+    printf("Vazão máxima do servidor: %.2f kB/s\n", vazao_maxima);
+    printf("Threads de eventos: %d%s\n", num_lacos, escuta_por_nucleo ? " (uma escuta por núcleo)" : "");
+
+    for (int i = 0; i < num_lacos; i++) {
+        lacos[i].anel.fd = -1;
+        slab_iniciar(&lacos[i].conexoes, sizeof(Conexao), CONEXOES_POR_BLOCO);
+        arena_iniciar(&lacos[i].buffers);
+    }
+    if (usar_anel && iniciar_aneis() != 0) {
+        perror("io_uring indisponível, usando epoll");
+        usar_anel = 0;
+    }
+    printf("Motor de eventos: %s\n", usar_anel ? "io_uring" : "epoll");
+
+    for (int i = 0; i < num_lacos; i++) {
+        roda_iniciar(&lacos[i].roda, agora_us());
+        // Concessões da fila chegam de outras threads: o eventfd acorda o laço dono da conexão
+        lacos[i].aviso_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (lacos[i].aviso_fd < 0) {
+            perror("Erro no eventfd");
+            exit(EXIT_FAILURE);
+        }
+        atomic_init(&lacos[i].concedidas, NULL);
+        if (usar_anel) {
+            iniciar_thread(&lacos[i], i, laco_anel);
+            continue;
+        }
+
+        lacos[i].epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (lacos[i].epfd < 0) {
+            perror("Erro no epoll_create1");
+            exit(EXIT_FAILURE);
+        }
+        // EPOLLEXCLUSIVE: cada nova conexão acorda só uma das threads
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = NULL };
+        if (epoll_ctl(lacos[i].epfd, EPOLL_CTL_ADD, lacos[i].server_fd, &ev) < 0) {
+            perror("Erro no epoll_ctl");
+            exit(EXIT_FAILURE);
+        }
+        ev = (struct epoll_event){ .events = EPOLLIN, .data.ptr = &lacos[i] };
+        if (epoll_ctl(lacos[i].epfd, EPOLL_CTL_ADD, lacos[i].aviso_fd, &ev) < 0) {
+            perror("Erro no epoll_ctl");
+            exit(EXIT_FAILURE);
+        }
+        iniciar_thread(&lacos[i], i, laco_eventos);
+    }
+
+    pthread_create(&thread_monitor, NULL, monitorar_clientes, NULL);
+    pthread_t thread_qos;
+    pthread_create(&thread_qos, NULL, vigiar_qos, NULL);
+
+    for (int i = 0; i < num_lacos; i++)
+        pthread_join(lacos[i].thread, NULL);
+
+    for (int i = 0; i < num_lacos; i++)
+        if (lacos[i].server_fd != server_fd) close(lacos[i].server_fd);
+    close(server_fd);
+    return 0;
+}
+
+int abrir_escuta(int porta, int backlog, int reuseport) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
         perror("Erro ao criar socket");
         exit(EXIT_FAILURE);
     }
 
     int on = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        perror("Erro no SO_REUSEPORT");
+        exit(EXIT_FAILURE);
+    }
 
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(porta);
+    // Herdados pelas conexões aceitas (o de recepção precisa vir antes do listen para valer na janela)
+    if (buf_envio > 0 && setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buf_envio, sizeof(buf_envio)) < 0)
+        perror("Aviso: SO_SNDBUF");
+    if (buf_recepcao > 0 && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buf_recepcao, sizeof(buf_recepcao)) < 0)
+        perror("Aviso: SO_RCVBUF");
 
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_addr.s_addr = INADDR_ANY, .sin_port = htons(porta) };
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
         perror("Erro no bind");
         exit(EXIT_FAILURE);
     }
 
-    if (listen(server_fd, 10) < 0) {
+    if (listen(fd, backlog) < 0) {
         perror("Erro no listen");
         exit(EXIT_FAILURE);
     }
+    return fd;
+}
 
-    printf("Servidor iniciado na porta %d...\n", porta);
-    printf("Vazão máxima do servidor: %.2f kB/s\n", vazao_maxima);
+// O kernel escolhe o socket do grupo SO_REUSEPORT pelo núcleo que recebeu o SYN (CPU % threads,
+// na ordem dos listen): a conexão fica no núcleo cuja thread a aceita. Sem o filtro, a escolha
+// é por hash do endereço, que ainda reparte a carga
+void direcionar_por_cpu(int server_fd) {
+    struct sock_filter codigo[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)num_lacos },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog prog = { .len = sizeof(codigo) / sizeof(codigo[0]), .filter = codigo };
+    if (setsockopt(server_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0)
+        perror("Aviso: sem direcionamento de conexões por núcleo");
+}
 
-    pthread_create(&thread_monitor, NULL, monitorar_clientes, NULL);
+// Com -p a thread i fica presa ao i-ésimo núcleo permitido ao processo (o mesmo que o filtro de
+// direcionamento escolhe quando os núcleos são 0..N-1)
+void iniciar_thread(LacoEventos *laco, int indice, void *(*funcao)(void *)) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    cpu_set_t permitidos;
+    if (escuta_por_nucleo && sched_getaffinity(0, sizeof(permitidos), &permitidos) == 0) {
+        int alvo = indice % CPU_COUNT(&permitidos);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (!CPU_ISSET(cpu, &permitidos) || alvo-- > 0) continue;
+            cpu_set_t nucleo;
+            CPU_ZERO(&nucleo);
+            CPU_SET(cpu, &nucleo);
+            pthread_attr_setaffinity_np(&attr, sizeof(nucleo), &nucleo);
+            break;
+        }
+    }
+    if (pthread_create(&laco->thread, &attr, funcao, laco) != 0) {
+        perror("Erro ao criar thread de eventos");
+        exit(EXIT_FAILURE);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+void carregar_qos(const char *arquivo_qos) {
+    TabelaQoS *t = qos_carregar(arquivo_qos, TX_PADRAO);
+    if (!t) {
+        perror("Erro ao abrir arquivo QoS");
+        // Sem regras: todos os IPs ficam com a taxa padrão
+        t = qos_criar(TX_PADRAO);
+        if (!t || qos_construir(t) != 0) {
+            perror("Erro ao criar tabela QoS");
+            exit(EXIT_FAILURE);
+        }
+    }
+    atomic_store(&qos, t);
+    printf("QoS carregado: %zu regras\n", qos_num_regras(t));
+}
+
+// Monta a tabela nova fora dos laços, publica e libera a antiga quando ninguém mais a lê
+void recarregar_qos(void) {
+    TabelaQoS *nova = qos_carregar(arquivo_qos, TX_PADRAO);
+    if (!nova) {
+        perror("Erro ao recarregar arquivo QoS; mantendo as regras atuais");
+        return;
+    }
+    TabelaQoS *antiga = atomic_exchange(&qos, nova);
+    uint64_t geracao = atomic_fetch_add(&geracao_qos, 1) + 1;
+    esperar_quiescencia(geracao);
+    qos_liberar(antiga);
+    printf("QoS recarregado: %zu regras\n", qos_num_regras(nova));
+}
+
+// Um laço que dorme no epoll (época 0) ou que acordou depois da troca (época >= geracao)
+// não guarda mais o ponteiro antigo: ele só é lido durante o tratamento de um evento
+void esperar_quiescencia(uint64_t geracao) {
+    for (int i = 0; i < num_lacos; i++) {
+        uint64_t e;
+        while ((e = atomic_load(&lacos[i].epoca)) != 0 && e < geracao) {
+            struct timespec ts = { 0, 1000000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+}
+
+// Recarrega o QoS no SIGHUP ou quando o arquivo é reescrito (inotify no diretório)
+void *vigiar_qos(void *arg) {
+    (void)arg;
+    sigset_t sinais;
+    sigemptyset(&sinais);
+    sigaddset(&sinais, SIGHUP);
+    struct pollfd fds[2] = { { .fd = signalfd(-1, &sinais, SFD_CLOEXEC), .events = POLLIN },
+                             { .fd = inotify_init1(IN_CLOEXEC), .events = POLLIN } };
+    if (fds[0].fd < 0) perror("Erro no signalfd");
+
+    char copia_dir[MAX_PATH], copia_nome[MAX_PATH];
+    snprintf(copia_dir, sizeof(copia_dir), "%s", arquivo_qos);
+    snprintf(copia_nome, sizeof(copia_nome), "%s", arquivo_qos);
+    const char *nome = basename(copia_nome);
+    if (fds[1].fd >= 0 &&
+        inotify_add_watch(fds[1].fd, dirname(copia_dir), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        perror("Erro no inotify do arquivo QoS; recarga só por SIGHUP");
+        close(fds[1].fd);
+        fds[1].fd = -1;
+    }
 
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (1) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("Erro no poll do QoS");
+            return NULL;
+        }
+        int recarregar = 0;
+        if (fds[0].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(fds[0].fd, &info, sizeof(info)) == sizeof(info)) recarregar = 1;
+        }
+        if (fds[1].revents & POLLIN) {
+            ssize_t n = read(fds[1].fd, buf, sizeof(buf));
+            for (char *p = buf; n > 0 && p < buf + n;) {
+                struct inotify_event *ev = (struct inotify_event *)p;
+                if (ev->len && strcmp(ev->name, nome) == 0) recarregar = 1;
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+        if (recarregar) recarregar_qos();
+    }
+    return NULL;
+}
+
+// Taxa da regra de prefixo mais longo que contém o IP (sem trava: leitura do snapshot atual)
+double buscar_taxa_ip(uint32_t ip) {
+    return qos_buscar_v4(atomic_load(&qos), ip);
+}
+
+// Transferência em curso passa para a taxa das regras novas, inclusive na reserva de vazão.
+// Um aumento que não cabe no orçamento é recusado: a conexão segue na taxa antiga
+void atualizar_taxa(Conexao *c) {
+    c->geracao_qos = atomic_load(&geracao_qos);
+    double nova = buscar_taxa_ip(c->ip_bin);
+    if (nova == c->taxa_kBps) return;
+    int64_t nova_Bps = orcamento_Bps(nova);
+    if (!orcamento_ajustar(&orcamento, c->reserva_Bps, nova_Bps)) return;
+    c->reserva_Bps = nova_Bps;
+    fila_despachar(&fila); // uma redução pode abrir espaço para quem espera
+    printf("[QoS] Cliente %s: %.2f -> %.2f kB/s\n", c->ip, c->taxa_kBps, nova);
+    c->taxa_kBps = nova;
+    if (redistribuir) {
+        alocador_ajustar_peso(&alocador, &c->fatia, nova); // o ritmo novo vem pela geração
+    } else {
+        c->ritmo_kBps = nova;
+        balde_ajustar_taxa(&c->balde, nova, agora_us());
+    }
+}
+
+// Mede a taxa alcançada e segue a divisão atual da vazão. Quem enche o socket sem alcançar
+// o próprio ritmo passa a pedir só o que alcança; quem volta a acompanhar é liberado e testa
+// de novo a parte inteira
+void acompanhar_alocacao(Conexao *c) {
+    uint64_t agora = agora_us();
+    if (agora - c->janela_us >= JANELA_DEMANDA_US) {
+        double alcancada = c->janela_bytes / 1024.0 / ((agora - c->janela_us) / 1e6);
+        if (c->janela_cheia && alcancada < 0.8 * c->ritmo_kBps)
+            alocador_limitar(&alocador, &c->fatia, alcancada * 1.25);
+        else if (c->fatia.demanda > 0 && !c->janela_cheia)
+            alocador_limitar(&alocador, &c->fatia, 0);
+        c->janela_us = agora;
+        c->janela_bytes = 0;
+        c->janela_cheia = 0;
+    }
+    uint64_t geracao = alocador_geracao(&alocador);
+    if (geracao != c->geracao_alocacao) {
+        c->geracao_alocacao = geracao;
+        c->ritmo_kBps = alocador_taxa(&alocador, &c->fatia);
+        balde_ajustar_taxa(&c->balde, c->ritmo_kBps, agora);
+    }
+}
+
+// Laço principal de uma thread de eventos
+void *laco_eventos(void *arg) {
+    LacoEventos *laco = arg;
+    struct epoll_event eventos[MAX_EVENTOS];
+
+    while (1) {
+        // Dorme até o próximo evento ou até a roda precisar avançar (resolução de µs)
+        roda_avancar(&laco->roda, agora_us());
+        uint64_t espera = roda_espera_us(&laco->roda);
+        struct timespec ts = { .tv_sec = (time_t)(espera / 1000000), .tv_nsec = (long)(espera % 1000000) * 1000 };
+
+        atomic_store(&laco->epoca, 0); // quiescente enquanto dorme
+        int n = epoll_pwait2(laco->epfd, eventos, MAX_EVENTOS, espera == UINT64_MAX ? NULL : &ts, NULL);
+        if (n < 0 && errno == ENOSYS) // kernel sem epoll_pwait2: resolução de ms
+            n = epoll_wait(laco->epfd, eventos, MAX_EVENTOS,
+                           espera == UINT64_MAX ? -1 : (int)((espera + 999) / 1000));
+        atomic_store(&laco->epoca, atomic_load(&geracao_qos));
+        if (n < 0 && errno != EINTR) {
+            perror("Erro no epoll_wait");
+            continue;
+        }
+
+        for (int i = 0; i < n; i++) {
+            Conexao *c = eventos[i].data.ptr;
+            if (c == NULL) {
+                aceitar_conexoes(laco);
+                continue;
+            }
+            if ((void *)c == laco) {
+                receber_concessoes(laco);
+                continue;
+            }
+            if (eventos[i].events & (EPOLLERR | EPOLLHUP)) {
+                fechar_conexao(laco, c);
+                continue;
+            }
+            if (c->estado == CONEXAO_LENDO && (eventos[i].events & EPOLLIN))
+                ler_requisicao(laco, c);
+            else if (c->estado == CONEXAO_ENVIANDO && (eventos[i].events & EPOLLOUT))
+                enviar_resposta(laco, c);
+        }
+
+        tratar_expirados(laco);
+    }
+    return NULL;
+}
+
+// Retoma as conexões cuja pausa terminou e fecha as ociosas e as lentas demais. Fechar devolve
+// a banda reservada: clientes que não leem nem escrevem não esgotam a vazão
+void tratar_expirados(LacoEventos *laco) {
+    roda_avancar(&laco->roda, agora_us());
+    Timer *t;
+    while ((t = roda_proximo_expirado(&laco->roda)) != NULL) {
+        Conexao *c = container_of(t, Conexao, timer);
+        if (c->estado == CONEXAO_LENDO) {
+            if (c->prazo_cabecalho) metricas_contar(CONT_PRAZOS_LEITURA, 1);
+            fechar_conexao(laco, c);
+            continue;
+        }
+        if (c->estado == CONEXAO_ENVIANDO) { // socket cheio pelo prazo todo: o cliente parou de ler
+            metricas_contar(CONT_PRAZOS_ESCRITA, 1);
+            fechar_conexao(laco, c);
+            continue;
+        }
+        if (c->estado == CONEXAO_AGUARDANDO) {
+            // Prazo esgotado; se a concessão já saiu da fila, ela chega pelo eventfd
+            if (fila_sair(&fila, &c->espera)) {
+                metricas_contar(CONT_ESPERAS_EXPIRADAS, 1);
+                recusar_admissao(laco, c);
+            }
+            continue;
+        }
+        c->estado = CONEXAO_ENVIANDO;
+        enviar_resposta(laco, c);
+    }
+}
+
+void aceitar_conexoes(LacoEventos *laco) {
     while (1) {
         struct sockaddr_in cliente_addr;
         socklen_t cliente_len = sizeof(cliente_addr);
-        int new_socket = accept(server_fd, (struct sockaddr *)&cliente_addr, &cliente_len);
-        if (new_socket < 0) {
-            perror("Erro no accept");
+        int sock = accept4(laco->server_fd, (struct sockaddr *)&cliente_addr, &cliente_len,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (sock < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("Erro no accept");
+            return;
+        }
+
+        Conexao *c = nova_conexao(laco, sock, &cliente_addr);
+        if (!c) {
+            close(sock);
             continue;
         }
 
-        pthread_t t;
-        struct {
-            int sock;
-            struct sockaddr_in addr;
-        } *arg_thread = malloc(sizeof(*arg_thread));
-        arg_thread->sock = new_socket;
-        arg_thread->addr = cliente_addr;
+        // Registrado uma única vez: leitura e escrita no modo edge-triggered
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLET, .data.ptr = c };
+        if (epoll_ctl(laco->epfd, EPOLL_CTL_ADD, sock, &ev) < 0) {
+            perror("Erro no epoll_ctl");
+            close(sock);
+            slab_devolver(&laco->conexoes, c);
+            continue;
+        }
+        armar_prazo_leitura(laco, c);
+        metricas_contar(CONT_CONEXOES_ACEITAS, 1);
+    }
+}
+
+// Entre requisições vale o prazo de ociosidade. Numa conexão nova, ou desde o primeiro byte de
+// uma requisição, vale o do cabeçalho, que não é renovado pelos bytes que chegam: quem manda a
+// requisição aos poucos (slowloris) é fechado no prazo do mesmo jeito
+void armar_prazo_leitura(LacoEventos *laco, Conexao *c) {
+    int cabecalho = c->req_len > 0 || c->atendidas == 0;
+    if (roda_agendado(&c->timer) && c->prazo_cabecalho == cabecalho) return; // já corre
+    c->prazo_cabecalho = cabecalho;
+    roda_agendar(&laco->roda, &c->timer, agora_us() + (cabecalho ? cabecalho_us : ocioso_us));
+}
+
+// Envio parado esperando espaço no socket: cada progresso renova o prazo (pausas do ritmo usam o
+// mesmo timer e não contam)
+void armar_prazo_escrita(LacoEventos *laco, Conexao *c) {
+    roda_agendar(&laco->roda, &c->timer, agora_us() + escrita_us);
+}
 
-        pthread_create(&t, NULL, atender_cliente, arg_thread);
-        pthread_detach(t);
+Conexao *nova_conexao(LacoEventos *laco, int sock, const struct sockaddr_in *addr) {
+    Conexao *c = slab_obter(&laco->conexoes);
+    if (!c) return NULL;
+    memset(c, 0, sizeof(*c));
+    c->sock = sock;
+    c->laco = laco;
+    c->espera.pos = -1;
+    envio_iniciar(&c->envio, -1, 0, 0);
+    parser_iniciar(&c->parser);
+    c->estado = CONEXAO_LENDO;
+    inet_ntop(AF_INET, &addr->sin_addr, c->ip, INET_ADDRSTRLEN);
+    c->ip_bin = ntohl(addr->sin_addr.s_addr);
+    return c;
+}
+
+void ler_requisicao(LacoEventos *laco, Conexao *c) {
+    if (!obter_req(laco, c)) {
+        fechar_conexao(laco, c);
+        return;
+    }
+    while (!c->fim_entrada && c->req_len < BUF_SIZE) {
+        ssize_t n = read(c->sock, c->req + c->req_len, BUF_SIZE - c->req_len);
+        if (n > 0) {
+            c->req_len += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0) {
+            fechar_conexao(laco, c);
+            return;
+        }
+        c->fim_entrada = 1; // cliente fechou: ainda atende o que já chegou
     }
+    soltar_req(laco, c); // nada chegou: a conexão ociosa não segura o buffer
+    analisar_requisicao(laco, c);
+}
 
-    close(server_fd);
-    return 0;
+// O buffer da requisição sai da arena da thread quando há bytes a receber e volta quando fica vazio
+int obter_req(LacoEventos *laco, Conexao *c) {
+    if (!c->req) c->req = arena_obter(&laco->buffers, BUF_SIZE);
+    return c->req != NULL;
 }
 
-void carregar_qos(const char *arquivo_qos) {
-    FILE *fp = fopen(arquivo_qos, "r");
-    if (!fp) {
-        perror("Erro ao abrir arquivo QoS");
+void soltar_req(LacoEventos *laco, Conexao *c) {
+    if (c->req && c->req_len == 0) {
+        arena_devolver(&laco->buffers, c->req, BUF_SIZE);
+        c->req = NULL;
+    }
+}
+
+// Resposta gerada na hora, num buffer da arena da thread dona da conexão
+char *obter_resposta(Conexao *c, size_t tam) {
+    c->resp_dinamica = arena_obter(&c->laco->buffers, tam);
+    c->resp_dinamica_tam = c->resp_dinamica ? tam : 0;
+    return c->resp_dinamica;
+}
+
+// Devolve à arena a resposta gerada e os cabeçalhos das partes do multipart
+void soltar_buffers(LacoEventos *laco, Conexao *c) {
+    arena_devolver(&laco->buffers, c->resp_dinamica, c->resp_dinamica_tam);
+    c->resp_dinamica = NULL;
+    arena_devolver(&laco->buffers, c->faixas.partes, c->faixas.partes_cap);
+    c->faixas.partes = NULL;
+}
+
+void analisar_requisicao(LacoEventos *laco, Conexao *c) {
+    // O parser continua de onde parou: só os bytes novos são examinados
+    ResultadoParser r = parser_executar(&c->parser, c->req, c->req_len);
+    if (r == PARSER_INCOMPLETO) {
+        if (c->fim_entrada) {
+            fechar_conexao(laco, c);
+        } else if (c->req_len == BUF_SIZE) {
+            roda_cancelar(&laco->roda, &c->timer);
+            c->chegada_us = agora_us();
+            c->manter_viva = 0;
+            responder_erro(c, "431 Request Header Fields Too Large");
+            enviar_resposta(laco, c);
+        } else {
+            armar_prazo_leitura(laco, c);
+            if (usar_anel) anel_receber(laco, c);
+        }
+        return;
+    }
+
+    roda_cancelar(&laco->roda, &c->timer);
+    c->chegada_us = agora_us();
+    if (r == PARSER_ERRO) {
+        c->manter_viva = 0;
+        responder_erro(c, texto_status(c->parser.erro));
+        enviar_resposta(laco, c);
+        return;
+    }
+    c->req_usado = c->parser.fim;
+    processar_requisicao(laco, c);
+}
+
+void processar_requisicao(LacoEventos *laco, Conexao *c) {
+    const ParserHttp *p = &c->parser;
+
+    // HTTP/1.1 é persistente por padrão; HTTP/1.0 só com "Connection: keep-alive"
+    if (p->versao_menor >= 1)
+        c->manter_viva = !trecho_contem_token(c->req, p->connection, "close");
+    else
+        c->manter_viva = trecho_contem_token(c->req, p->connection, "keep-alive");
+    c->atendidas++;
+    if (c->atendidas >= max_req_conexao) c->manter_viva = 0;
+    // Com o envio do cliente encerrado, as requisições completas já recebidas ainda são
+    // respondidas em ordem; a conexão fecha depois da última
+    if (c->fim_entrada && !requisicao_seguinte_completa(c)) c->manter_viva = 0;
+    // O corpo de uma requisição não é lido: os bytes dele não podem ser tomados pela próxima
+    if (p->transfer_encoding.len > 0 || (p->content_length.len > 0 && !trecho_igual(c->req, p->content_length, "0")))
+        c->manter_viva = 0;
+
+    c->cabeca = trecho_igual(c->req, p->metodo, "HEAD");
+    if (!c->cabeca && !trecho_igual(c->req, p->metodo, "GET")) {
+        c->manter_viva = 0;
+        responder_erro(c, "501 Not Implemented");
+        enviar_resposta(laco, c);
+        return;
+    }
+
+    if (trecho_igual(c->req, p->alvo, "/metrics")) {
+        responder_metricas(c);
+        enviar_resposta(laco, c);
+        return;
+    }
+
+    Asset *asset = rotas_buscar(&rotas, c->req + p->alvo.inicio, p->alvo.len);
+    VersaoAsset *v = asset ? cache_obter(asset) : NULL;
+    if (v == NULL) {
+        responder_erro(c, "404 Not Found");
+        enviar_resposta(laco, c);
+        return;
+    }
+
+    c->versao = v;
+    if (!preparar_corpo(c)) { // 304, 416 (ou falta de memória): não ocupa banda
+        enviar_resposta(laco, c);
         return;
     }
-    qos_count = 0;
-    while (fscanf(fp, "%s %lf", qos_ips[qos_count].ip, &qos_ips[qos_count].taxa_kBps) == 2) {
-        qos_count++;
-    }
-    fclose(fp);
-    printf("QoS carregado: %d IPs\n", qos_count);
-}
-
-double buscar_taxa_ip(const char *ip) {
-    for (int i = 0; i < qos_count; i++) {
-        if (strcmp(ip, qos_ips[i].ip) == 0)
-            return qos_ips[i].taxa_kBps;
-    }
-    return TX_PADRAO;
-}
-
-void *atender_cliente(void *arg) {
-    struct {
-        int sock;
-        struct sockaddr_in addr;
-    } *dados = arg;
-
-    int sock = dados->sock;
-    struct sockaddr_in cliente_addr = dados->addr;
-    free(dados);
-
-    char ip_cliente[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &cliente_addr.sin_addr, ip_cliente, INET_ADDRSTRLEN);
-
-    pthread_mutex_lock(&lock);
-    int idx = buscar_cliente(ip_cliente);
-    if (idx == -1) idx = registrar_cliente(ip_cliente);
-    pthread_mutex_unlock(&lock);
-
-    char buffer[BUF_SIZE];
-    ssize_t n = read(sock, buffer, sizeof(buffer) - 1);
-    if (n <= 0) {
-        close(sock);
-        return NULL;
-    }
-    buffer[n] = '\0';
-
-    char metodo[8], caminho[128];
-    sscanf(buffer, "%s %s", metodo, caminho);
-
-    const char *arquivo = NULL;
-    if (strcmp(caminho, "/html") == 0) arquivo = "html_simulado.txt";
-    else if (strcmp(caminho, "/gato.jpg") == 0) arquivo = "gato.jpg";
-    else if (strcmp(caminho, "/banda.jpg") == 0) arquivo = "banda.jpg";
-    else if (strcmp(caminho, "/carro.jpg") == 0) arquivo = "carro.jpg";
-    else if (strcmp(caminho, "/jogo.jpg") == 0) arquivo = "jogo.jpg";
-    else {
-        const char *msg = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
-        send(sock, msg, strlen(msg), 0);
-        close(sock);
-        return NULL;
-    }
-
-    double taxa_cliente = buscar_taxa_ip(ip_cliente);
-
-    pthread_mutex_lock(&lock);
-    if (vazao_atual + taxa_cliente > vazao_maxima) {
-        const char *msg = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
-        send(sock, msg, strlen(msg), 0);
-        if (requisicao_count < MAX_REQUISICOES) {
-            requisicoes[requisicao_count].id_requisicao = requisicao_count + 1;
-            strcpy(requisicoes[requisicao_count].ip, ip_cliente);
-            requisicoes[requisicao_count].rtt = 0;
-            requisicoes[requisicao_count].bandwidth = 0;
-            requisicoes[requisicao_count].thread_id = pthread_self();
-            requisicoes[requisicao_count].rejeitada = 1;
-            requisicao_count++;
-        }
-        printf("[RECUSA] Cliente %s recusado: limite de banda atingido.\n", ip_cliente);
-        pthread_mutex_unlock(&lock);
-        close(sock);
-        return NULL;
-    }
-    vazao_atual += taxa_cliente;
-    pthread_mutex_unlock(&lock);
-
-    struct timeval inicio, fim;
-    gettimeofday(&inicio, NULL);
-    enviar_arquivo(sock, arquivo, taxa_cliente);
+    if (c->cabeca) { // HEAD: o mesmo cabeçalho do GET, sem corpo e sem passar pela admissão
+        envio_iniciar(&c->envio, -1, 0, 0);
+        c->resp_enviado = 0;
+        c->estado = CONEXAO_ENVIANDO;
+        enviar_resposta(laco, c);
+        return;
+    }
+    c->geracao_qos = atomic_load(&geracao_qos);
+    c->taxa_kBps = buscar_taxa_ip(c->ip_bin);
+    c->reserva_Bps = orcamento_Bps(c->taxa_kBps);
+
+    // Admissão: reserva a taxa do cliente no orçamento do servidor (CAS, sem trava).
+    // Com requisições já na fila, a nova entra nela: ninguém fura a ordem justa
+    if (fila_tamanho(&fila) == 0 && orcamento_reservar(&orcamento, c->reserva_Bps)) {
+        c->reservou = 1;
+        iniciar_envio(laco, c);
+        return;
+    }
+    if (espera_max_us > 0) {
+        c->estado = CONEXAO_AGUARDANDO;
+        roda_agendar(&laco->roda, &c->timer, agora_us() + espera_max_us);
+        if (fila_entrar(&fila, &c->espera, c->ip_bin, c->taxa_kBps, c->reserva_Bps)) return;
+        roda_cancelar(&laco->roda, &c->timer);
+    }
+    recusar_admissao(laco, c);
+}
+
+// Há outra requisição inteira no buffer depois desta?
+int requisicao_seguinte_completa(const Conexao *c) {
+    ParserHttp prox;
+    parser_iniciar(&prox);
+    return parser_executar(&prox, c->req + c->parser.fim, c->req_len - c->parser.fim) == PARSER_OK;
+}
+
+// Sem banda: responde 503 e devolve o arquivo ao cache
+void recusar_admissao(LacoEventos *laco, Conexao *c) {
+    cache_soltar(c->versao);
+    c->versao = NULL;
+    registrar_requisicao(c, 0, 0, 1);
+    metricas_contar(CONT_RECUSAS, 1);
+    printf("[RECUSA] Cliente %s recusado: limite de banda atingido.\n", c->ip);
+    responder_erro(c, "503 Service Unavailable");
+    enviar_resposta(laco, c);
+}
+
+// Chamada pela fila (em qualquer thread) com a banda já reservada: avisa o laço dono
+void conceder_admissao(EsperaAdmissao *e) {
+    LacoEventos *laco = container_of(e, Conexao, espera)->laco;
+    e->prox = atomic_load(&laco->concedidas);
+    while (!atomic_compare_exchange_weak(&laco->concedidas, &e->prox, e));
+    uint64_t um = 1;
+    if (write(laco->aviso_fd, &um, sizeof(um)) < 0 && errno != EAGAIN)
+        perror("Erro ao avisar laço");
+}
+
+void receber_concessoes(LacoEventos *laco) {
+    uint64_t avisos;
+    if (read(laco->aviso_fd, &avisos, sizeof(avisos)) < 0 && errno != EAGAIN)
+        perror("Erro no eventfd");
+    EsperaAdmissao *e = atomic_exchange(&laco->concedidas, NULL);
+    while (e) {
+        EsperaAdmissao *prox = e->prox;
+        Conexao *c = container_of(e, Conexao, espera);
+        c->reservou = 1;
+        if (c->descartada) {
+            liberar_reserva(c);
+            slab_devolver(&laco->conexoes, c);
+        } else {
+            roda_cancelar(&laco->roda, &c->timer);
+            metricas_registrar(HIST_ESPERA_US, agora_us() - c->chegada_us);
+            iniciar_envio(laco, c);
+        }
+        e = prox;
+    }
+}
+
+// Negocia a codificação pelo Accept-Encoding: a variante comprimida de maior peso (brotli no
+// empate), senão o arquivo original. O balde de fichas mede os bytes comprimidos
+const Representacao *escolher_representacao(const Conexao *c) {
+    const VersaoAsset *v = c->versao;
+    int melhor = COD_IDENTIDADE, q_melhor = 0;
+    for (int k = NUM_CODIFICACOES - 1; k > COD_IDENTIDADE; k--) {
+        if (v->rep[k].fd < 0) continue;
+        int q = trecho_qualidade(c->req, c->parser.accept_encoding, v->rep[k].nome);
+        if (q > q_melhor) {
+            melhor = k;
+            q_melhor = q;
+        }
+    }
+    return &v->rep[melhor];
+}
+
+// Escolhe o corpo: 304 se a cópia do cliente ainda vale, o arquivo inteiro (200, com o cabeçalho
+// pronto do cache), as faixas pedidas em Range (206) ou 416 quando nenhuma cabe no arquivo.
+// Retorna 0 se a resposta ficou sem corpo
+int preparar_corpo(Conexao *c) {
+    VersaoAsset *v = c->versao;
+    const ParserHttp *p = &c->parser;
+    RespostaFaixas *r = &c->faixas;
+    const char *conexao = c->manter_viva ? "keep-alive" : "close";
+    const Representacao *rp = c->rep = escolher_representacao(c);
+
+    if (nao_modificado(c)) { // só o cabeçalho: não passa pela admissão nem consome banda
+        c->status = 304;
+        c->resp_ptr = c->resposta;
+        c->resp_len = snprintf(c->resposta, sizeof(c->resposta),
+                               "HTTP/1.1 304 Not Modified\r\n%sETag: %s\r\nLast-Modified: %s\r\n"
+                               "Cache-Control: %s\r\nConnection: %s\r\n\r\n",
+                               rp->cab_codificacao, rp->etag, v->modificado, cache_controle(), conexao);
+        cache_soltar(v);
+        c->versao = NULL;
+        c->resp_enviado = 0;
+        c->estado = CONEXAO_ENVIANDO;
+        return 0;
+    }
+
+    ResultadoFaixas res = FAIXAS_IGNORAR;
+    if (p->range.len > 0 && if_range_vale(c))
+        res = faixas_ler(c->req + p->range.inicio, p->range.len, (off_t)rp->tamanho, r);
+
+    if (res == FAIXAS_IGNORAR) {
+        r->n = 1;
+        r->faixa[0].inicio = 0;
+        r->faixa[0].fim = (off_t)rp->tamanho;
+        r->partes = NULL;
+        c->corpo_len = (off_t)rp->tamanho;
+        c->resp_ptr = c->manter_viva ? rp->cab_viva : rp->cab_fechar;
+        c->resp_len = c->manter_viva ? rp->cab_viva_len : rp->cab_fechar_len;
+        c->status = 200;
+        return 1;
+    }
+
+    if (res == FAIXAS_INSATISFAZIVEL) {
+        cache_soltar(v);
+        c->versao = NULL;
+        c->status = 416;
+        c->resp_ptr = c->resposta;
+        c->resp_len = snprintf(c->resposta, sizeof(c->resposta),
+                               "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%zu\r\n"
+                               "Content-Length: 0\r\nConnection: %s\r\n\r\n",
+                               rp->tamanho, conexao);
+        c->resp_enviado = 0;
+        c->estado = CONEXAO_ENVIANDO;
+        return 0;
+    }
+
+    char cab[512];
+    int cab_len;
+    if (r->n == 1) {
+        c->corpo_len = r->faixa[0].fim - r->faixa[0].inicio;
+        cab_len = snprintf(cab, sizeof(cab),
+                           "HTTP/1.1 206 Partial Content\r\nContent-Type: %s\r\n"
+                           "Content-Range: bytes %lld-%lld/%zu\r\nContent-Length: %lld\r\n%s"
+                           "ETag: %s\r\nLast-Modified: %s\r\nCache-Control: %s\r\n"
+                           "Accept-Ranges: bytes\r\nConnection: %s\r\n\r\n",
+                           v->tipo, (long long)r->faixa[0].inicio, (long long)r->faixa[0].fim - 1,
+                           rp->tamanho, (long long)c->corpo_len, rp->cab_codificacao, rp->etag, v->modificado,
+                           cache_controle(), conexao);
+    } else {
+        // Várias faixas: cada parte leva o próprio Content-Range; o separador vem do ETag
+        char separador[32];
+        snprintf(separador, sizeof(separador), "faixas_%.16s", rp->etag + 1);
+        size_t cap = faixas_partes_cap(r, v->tipo, separador);
+        char *buf = arena_obter(&c->laco->buffers, cap);
+        c->corpo_len = buf ? faixas_montar_partes(r, buf, cap, v->tipo, separador, (off_t)rp->tamanho) : -1;
+        cab_len = snprintf(cab, sizeof(cab),
+                           "HTTP/1.1 206 Partial Content\r\n"
+                           "Content-Type: multipart/byteranges; boundary=%s\r\nContent-Length: %lld\r\n%s"
+                           "ETag: %s\r\nLast-Modified: %s\r\nCache-Control: %s\r\n"
+                           "Accept-Ranges: bytes\r\nConnection: %s\r\n\r\n",
+                           separador, (long long)c->corpo_len, rp->cab_codificacao, rp->etag, v->modificado,
+                           cache_controle(), conexao);
+    }
+    if (c->corpo_len < 0 || !obter_resposta(c, cab_len)) {
+        soltar_buffers(c->laco, c);
+        cache_soltar(v);
+        c->versao = NULL;
+        responder_erro(c, "500 Internal Server Error");
+        return 0;
+    }
+    memcpy(c->resp_dinamica, cab, cab_len);
+    c->resp_ptr = c->resp_dinamica;
+    c->resp_len = cab_len;
+    c->status = 206;
+    return 1;
+}
+
+// If-Range: a faixa só vale se o validador ainda é o da versão atual (ETag forte ou a data exata);
+// senão o cliente recebe o arquivo inteiro em vez de juntar pedaços de versões diferentes
+int if_range_vale(const Conexao *c) {
+    Trecho t = c->parser.if_range;
+    if (t.len == 0) return 1;
+    if (c->req[t.inicio] == '"') return trecho_igual(c->req, t, c->rep->etag);
+    time_t data;
+    return trecho_data(c->req, t, &data) && data == c->versao->mtime;
+}
+
+// If-None-Match tem precedência; If-Modified-Since só é considerado sem ele
+int nao_modificado(const Conexao *c) {
+    const ParserHttp *p = &c->parser;
+    if (p->if_none_match.len > 0) return trecho_contem_etag(c->req, p->if_none_match, c->rep->etag);
+    time_t data;
+    return trecho_data(c->req, p->if_modified_since, &data) && c->versao->mtime <= data;
+}
+
+// Banda reservada: cabeçalho e corpo saem direto do cache, sem open/stat por requisição
+void iniciar_envio(LacoEventos *laco, Conexao *c) {
+    envio_iniciar(&c->envio, c->rep->fd, c->faixas.faixa[0].inicio, c->faixas.faixa[0].fim);
+    c->faixa_atual = 0;
+    c->parte_enviado = 0;
+    c->ritmo_kBps = c->taxa_kBps;
+    if (redistribuir) {
+        alocador_entrar(&alocador, &c->fatia, c->taxa_kBps);
+        c->geracao_alocacao = alocador_geracao(&alocador);
+        c->ritmo_kBps = alocador_taxa(&alocador, &c->fatia);
+        c->janela_us = agora_us();
+        c->janela_bytes = 0;
+        c->janela_cheia = 0;
+    }
+    balde_iniciar(&c->balde, c->ritmo_kBps, rajada_bytes, agora_us());
+    c->resp_enviado = 0;
+    c->estado = CONEXAO_ENVIANDO;
+    gettimeofday(&c->inicio, NULL);
+    enviar_resposta(laco, c);
+}
+
+// Prepara uma resposta sem corpo com o status dado
+void responder_erro(Conexao *c, const char *status) {
+    c->status = atoi(status);
+    c->resp_ptr = c->resposta;
+    c->resp_len = snprintf(c->resposta, sizeof(c->resposta),
+                           "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n",
+                           status, c->manter_viva ? "keep-alive" : "close");
+    c->resp_enviado = 0;
+    c->estado = CONEXAO_ENVIANDO;
+}
+
+// Métricas de todas as threads somadas no momento, mais as medidas globais do servidor. O corpo é
+// escrito direto num buffer da arena, depois de um espaço reservado onde o cabeçalho entra logo
+// antes dele; se não couber na classe de 16 KB, tenta a de 64 KB
+void responder_metricas(Conexao *c) {
+    static const size_t tamanhos[] = { 16 * 1024, 64 * 1024 };
+    for (size_t k = 0; k < sizeof(tamanhos) / sizeof(tamanhos[0]); k++) {
+        if (!obter_resposta(c, tamanhos[k])) break;
+        char *corpo = c->resp_dinamica + METRICAS_CAB_MAX;
+        TextoMetricas t = { corpo, tamanhos[k] - METRICAS_CAB_MAX, 0 };
+        metricas_escrever(&t);
+        metricas_texto(&t, "# HELP servidor_vazao_kBps Banda reservada pelas transferências em curso\n"
+                           "# TYPE servidor_vazao_kBps gauge\nservidor_vazao_kBps %.2f\n"
+                           "# HELP servidor_vazao_maxima_kBps Limite de banda do servidor\n"
+                           "# TYPE servidor_vazao_maxima_kBps gauge\nservidor_vazao_maxima_kBps %.2f\n"
+                           "# HELP servidor_banda_distribuida_kBps Soma dos ritmos das transferências ativas\n"
+                           "# TYPE servidor_banda_distribuida_kBps gauge\nservidor_banda_distribuida_kBps %.2f\n"
+                           "# HELP servidor_fila_admissao Requisições esperando banda na fila de admissão\n"
+                           "# TYPE servidor_fila_admissao gauge\nservidor_fila_admissao %zu\n"
+                           "# HELP servidor_clientes Clientes com estatísticas guardadas\n"
+                           "# TYPE servidor_clientes gauge\nservidor_clientes %zu\n"
+                           "# HELP servidor_historico_descartados_total Registros perdidos com o anel cheio\n"
+                           "# TYPE servidor_historico_descartados_total counter\nservidor_historico_descartados_total %llu\n"
+                           "# HELP servidor_historico_gravados_total Registros gravados no histórico em disco\n"
+                           "# TYPE servidor_historico_gravados_total counter\nservidor_historico_gravados_total %llu\n",
+                       orcamento_usado_kBps(&orcamento), vazao_maxima, alocador_total(&alocador), fila_tamanho(&fila),
+                       total_clientes(), (unsigned long long)historico_descartados(),
+                       (unsigned long long)historico_gravados());
+        if (t.len < t.cap) {
+            char cab[METRICAS_CAB_MAX];
+            int cab_len = snprintf(cab, sizeof(cab),
+                                   "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                   "Content-Length: %zu\r\nConnection: %s\r\n\r\n",
+                                   t.len, c->manter_viva ? "keep-alive" : "close");
+            memcpy(corpo - cab_len, cab, cab_len);
+            c->resp_ptr = corpo - cab_len;
+            c->resp_len = cab_len + (c->cabeca ? 0 : t.len);
+            c->resp_enviado = 0;
+            c->status = 200;
+            c->estado = CONEXAO_ENVIANDO;
+            return;
+        }
+        arena_devolver(&c->laco->buffers, c->resp_dinamica, c->resp_dinamica_tam);
+        c->resp_dinamica = NULL;
+    }
+    responder_erro(c, "500 Internal Server Error");
+}
+
+const char *texto_status(int status) {
+    switch (status) {
+    case 414: return "414 URI Too Long";
+    case 505: return "505 HTTP Version Not Supported";
+    default:  return "400 Bad Request";
+    }
+}
+
+// Envia o que o socket e o balde de fichas permitirem; sem fichas, pausa na roda do laço
+void enviar_resposta(LacoEventos *laco, Conexao *c) {
+    if (usar_anel) {
+        anel_enviar_resposta(laco, c);
+        return;
+    }
+    while (c->resp_enviado < c->resp_len && !juntar_cabecalho(c)) {
+        ssize_t n = send(c->sock, c->resp_ptr + c->resp_enviado,
+                         c->resp_len - c->resp_enviado, MSG_NOSIGNAL);
+        if (n > 0) {
+            contar_cabecalho(c, n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            armar_prazo_escrita(laco, c);
+            return;
+        }
+        fechar_conexao(laco, c);
+        return;
+    }
+
+    if (c->versao == NULL || c->cabeca) {
+        concluir_resposta(laco, c);
+        return;
+    }
+
+    if (atualizar_em_andamento && c->geracao_qos != atomic_load(&geracao_qos))
+        atualizar_taxa(c);
+    if (redistribuir) acompanhar_alocacao(c);
+
+    // Cada faixa sai do arquivo no ritmo do balde; no multipart, precedida do cabeçalho da sua parte
+    if (c->faixas.partes) tampar(c, 1);
+    for (;;) {
+        if (!enviar_parte(laco, c)) return;
+        while (!envio_concluido(&c->envio)) {
+            size_t fichas;
+            if (aguardar_fichas(laco, c, &fichas)) return;
+
+            ssize_t n = c->resp_enviado < c->resp_len ? enviar_junto(c, fichas)
+                                                      : envio_transmitir(&c->envio, c->sock, fichas);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) { // aguarda EPOLLOUT; fichas acumulam
+                    c->janela_cheia = 1;
+                    armar_prazo_escrita(laco, c);
+                    return;
+                }
+                fechar_conexao(laco, c);
+                return;
+            }
+            balde_consumir(&c->balde, n);
+            c->janela_bytes += n;
+            metricas_contar(CONT_BYTES_ENVIADOS, n);
+        }
+        if (!proxima_faixa(c)) break;
+    }
+    finalizar_requisicao(laco, c);
+}
+
+// Espera juntar uma fatia inteira (ou o que falta) antes de acordar de novo: sem fichas suficientes,
+// pausa na roda e retorna 1; senão devolve em 'fichas' quanto pode ser enviado agora
+int aguardar_fichas(LacoEventos *laco, Conexao *c, size_t *fichas) {
+    uint64_t agora = agora_us();
+    size_t alvo = envio_fatia_bytes(c->ritmo_kBps);
+    if (alvo > rajada_bytes) alvo = rajada_bytes;
+    if ((off_t)alvo > envio_restante(&c->envio)) alvo = (size_t)envio_restante(&c->envio);
+
+    *fichas = balde_disponivel(&c->balde, agora);
+    if (*fichas >= alvo) return 0;
+    tampar(c, 0); // o que ficou retido sai antes da pausa
+    c->estado = CONEXAO_PAUSADA;
+    uint64_t espera = balde_espera_us(&c->balde, alvo, agora);
+    // Taxa nula nunca repõe fichas: em vez de um prazo que dá a volta e vence na hora, confere
+    // de novo a cada fatia (a taxa pode subir pela redistribuição ou por um QoS recarregado)
+    if (espera == UINT64_MAX) espera = FATIA_MS * 1000ULL;
+    roda_agendar(&laco->roda, &c->timer, agora + espera);
+    return 1;
+}
+
+// Uma resposta com corpo de um só trecho não manda o cabeçalho sozinho: ele espera a primeira
+// fatia do corpo e os dois saem num único sendmsg (arquivos pequenos inteiros numa syscall)
+int juntar_cabecalho(const Conexao *c) {
+    return c->versao && !c->cabeca && !c->faixas.partes && c->rep->dados && !envio_concluido(&c->envio);
+}
+
+// Conta os primeiros 'n' bytes de um envio no cabeçalho pendente; retorna os que passaram dele
+size_t contar_cabecalho(Conexao *c, size_t n) {
+    size_t cab = c->resp_len - c->resp_enviado;
+    if (cab > n) cab = n;
+    if (cab > 0 && c->resp_enviado == 0) metricas_registrar(HIST_TTFB_US, agora_us() - c->chegada_us);
+    c->resp_enviado += cab;
+    return n - cab;
+}
+
+// Cabeçalho restante e até 'fichas' bytes do corpo, copiados do mapeamento do cache. Retorna os
+// bytes do corpo enviados (0 se só parte do cabeçalho coube) ou -1 com errno
+ssize_t enviar_junto(Conexao *c, size_t fichas) {
+    size_t junto = fichas < TRECHO_JUNTO_MAX ? fichas : TRECHO_JUNTO_MAX;
+    if ((off_t)junto > envio_restante(&c->envio)) junto = (size_t)envio_restante(&c->envio);
+    struct iovec iov[2] = {
+        { (char *)c->resp_ptr + c->resp_enviado, c->resp_len - c->resp_enviado },
+        { (char *)c->rep->dados + c->envio.offset, junto },
+    };
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+    ssize_t n;
+    while ((n = sendmsg(c->sock, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR);
+    if (n < 0) return -1;
+    size_t corpo = contar_cabecalho(c, n);
+    envio_avancar(&c->envio, corpo);
+    return corpo;
+}
+
+// TCP_CORK no multipart: cabeçalhos das partes e trechos do arquivo se juntam em segmentos cheios
+// em vez de cada parte fechar um segmento pequeno. Desligar empurra o que ficou retido
+void tampar(Conexao *c, int ligar) {
+    if (c->tampada == ligar) return;
+    setsockopt(c->sock, IPPROTO_TCP, TCP_CORK, &ligar, sizeof(ligar));
+    c->tampada = ligar;
+}
+
+// Cabeçalho da parte atual do multipart (ou o delimitador final), cobrado do balde como o corpo.
+// Retorna 0 se o socket encheu ou a conexão foi fechada
+int enviar_parte(LacoEventos *laco, Conexao *c) {
+    RespostaFaixas *r = &c->faixas;
+    if (!r->partes) return 1;
+    size_t fim = r->parte_ini[c->faixa_atual + 1];
+    size_t pos;
+    while ((pos = r->parte_ini[c->faixa_atual] + c->parte_enviado) < fim) {
+        ssize_t n = send(c->sock, r->partes + pos, fim - pos, MSG_NOSIGNAL);
+        if (n > 0) {
+            c->parte_enviado += n;
+            balde_consumir(&c->balde, n);
+            c->janela_bytes += n;
+            metricas_contar(CONT_BYTES_ENVIADOS, n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            c->janela_cheia = 1;
+            armar_prazo_escrita(laco, c);
+            return 0;
+        }
+        fechar_conexao(laco, c);
+        return 0;
+    }
+    return 1;
+}
+
+// Passa para a faixa seguinte (depois da última, para o delimitador final). Retorna 0 no fim do corpo
+int proxima_faixa(Conexao *c) {
+    RespostaFaixas *r = &c->faixas;
+    if (!r->partes || c->faixa_atual == r->n) return 0;
+    c->faixa_atual++;
+    c->parte_enviado = 0;
+    if (c->faixa_atual < r->n)
+        envio_reposicionar(&c->envio, r->faixa[c->faixa_atual].inicio, r->faixa[c->faixa_atual].fim);
+    return 1;
+}
+
+// Transferência concluída: atualiza estatísticas e libera a banda reservada
+void finalizar_requisicao(LacoEventos *laco, Conexao *c) {
+    struct timeval fim;
     gettimeofday(&fim, NULL);
 
-    double duracao = calcular_tempo(inicio, fim);
-    long tamanho_kB = tamanho_arquivo_kb(arquivo);
-
-    pthread_mutex_lock(&lock);
-    ClienteInfo *cli = &clientes[idx];
-    if (cli->requisicoes > 0)
-        cli->last_rtt = calcular_tempo(cli->last_request_time, inicio);
-    cli->last_bandwidth = tamanho_kB / duracao;
-    cli->last_request_time = inicio;
-    cli->requisicoes++;
-    cli->thread_id = pthread_self();
-
-    if (requisicao_count < MAX_REQUISICOES) {
-        requisicoes[requisicao_count].id_requisicao = requisicao_count + 1;
-        strcpy(requisicoes[requisicao_count].ip, ip_cliente);
-        requisicoes[requisicao_count].rtt = duracao;
-        requisicoes[requisicao_count].bandwidth = tamanho_kB / duracao;
-        requisicoes[requisicao_count].thread_id = pthread_self();
-        requisicoes[requisicao_count].rejeitada = 0;
-        requisicao_count++;
-    }
-    vazao_atual -= taxa_cliente;
-    pthread_mutex_unlock(&lock);
-
-    close(sock);
+    double duracao = calcular_tempo(c->inicio, fim);
+    long tamanho_kB = (long)(c->corpo_len / 1024);
+
+    // Só o shard do cliente é travado
+    uint8_t chave[16];
+    clientes_chave_v4(c->ip_bin, chave);
+    ClienteInfo *cli = clientes_obter(laco->clientes, chave, agora_us());
+    if (cli) {
+        if (cli->requisicoes > 0)
+            cli->last_rtt = calcular_tempo(cli->last_request_time, c->inicio);
+        cli->last_bandwidth = tamanho_kB / duracao;
+        cli->last_request_time = c->inicio;
+        cli->requisicoes++;
+        cli->thread_id = pthread_self();
+        clientes_soltar(laco->clientes, cli);
+    }
+
+    registrar_requisicao(c, duracao, tamanho_kB / duracao, 0);
+    metricas_registrar(HIST_BANDA_KBPS, (uint64_t)(c->corpo_len / 1024.0 / duracao));
+    concluir_resposta(laco, c);
+}
+
+// Resposta enviada: fecha a conexão ou passa para a próxima requisição do pipeline
+void concluir_resposta(LacoEventos *laco, Conexao *c) {
+    metricas_status(c->status);
+    metricas_registrar(HIST_LATENCIA_US, agora_us() - c->chegada_us);
+    soltar_buffers(laco, c);
+    liberar_reserva(c);
+    tampar(c, 0);
+    if (c->versao) {
+        envio_liberar(&c->envio);
+        cache_soltar(c->versao);
+        c->versao = NULL;
+    }
+    if (!c->manter_viva) {
+        fechar_conexao(laco, c);
+        return;
+    }
+
+    // Descarta a requisição atendida, mantendo os bytes das seguintes
+    memmove(c->req, c->req + c->req_usado, c->req_len - c->req_usado);
+    c->req_len -= c->req_usado;
+    c->req_usado = 0;
+    soltar_req(laco, c);
+    parser_iniciar(&c->parser);
+    c->resp_len = c->resp_enviado = 0;
+    c->estado = CONEXAO_LENDO;
+    roda_cancelar(&laco->roda, &c->timer); // prazo de escrita da resposta concluída
+    armar_prazo_leitura(laco, c);
+
+    // Dados que chegaram durante o envio não geram novo evento (edge-triggered): lê agora.
+    // No io_uring não há leitura em voo durante o envio: examina o que já está no buffer
+    if (usar_anel)
+        analisar_requisicao(laco, c);
+    else
+        ler_requisicao(laco, c);
+}
+
+void liberar_reserva(Conexao *c) {
+    if (!c->reservou) return;
+    orcamento_liberar(&orcamento, c->reserva_Bps);
+    c->reservou = 0;
+    alocador_sair(&alocador, &c->fatia); // a parte desta transferência volta para as outras
+    fila_despachar(&fila);
+}
+
+void fechar_conexao(LacoEventos *laco, Conexao *c) {
+    roda_cancelar(&laco->roda, &c->timer);
+    int concessao_a_caminho = (c->estado == CONEXAO_AGUARDANDO && !fila_sair(&fila, &c->espera));
+    liberar_reserva(c);
+    if (c->versao) {
+        envio_liberar(&c->envio);
+        cache_soltar(c->versao);
+    }
+    soltar_buffers(laco, c);
+    c->req_len = 0;
+    soltar_req(laco, c);
+    if (c->ops_anel > 0) shutdown(c->sock, SHUT_RDWR); // conclui as operações em voo no anel
+    close(c->sock); // também remove o socket do epoll
+    metricas_contar(CONT_CONEXOES_FECHADAS, 1);
+    // O ponteiro ainda está na pilha de concessões: receber_concessoes devolve a banda e libera
+    if (concessao_a_caminho) {
+        c->descartada = 1;
+        c->versao = NULL;
+        return;
+    }
+    if (c->ops_anel > 0) { // as conclusões pendentes ainda apontam para a conexão
+        c->fechada = 1;
+        c->versao = NULL;
+        return;
+    }
+    slab_devolver(&laco->conexoes, c);
+}
+
+// Um anel io_uring por thread; se algum não puder ser criado, todos são desfeitos e o servidor
+// fica no epoll
+int iniciar_aneis(void) {
+    for (int i = 0; i < num_lacos; i++) {
+        if (anel_iniciar(&lacos[i].anel, ANEL_ENTRADAS) != 0 ||
+            anel_buffers_iniciar(&lacos[i].anel, 0, ANEL_BUFFERS, BUF_SIZE) != 0) {
+            int erro = errno;
+            for (int k = 0; k <= i; k++) anel_liberar(&lacos[k].anel);
+            errno = erro;
+            return -1;
+        }
+        lacos[i].prazo_armado = UINT64_MAX;
+    }
+    return 0;
+}
+
+static uint64_t dado_anel(void *ptr, OperacaoAnel op) {
+    return (uint64_t)(uintptr_t)ptr | op;
+}
+
+// Laço de uma thread no motor io_uring: o mesmo ciclo de vida do epoll, mas cada operação é
+// submetida ao anel e continuada na sua conclusão. Uma só entrada no kernel por volta submete
+// tudo o que foi preparado e espera as conclusões (ou o prazo da roda)
+void *laco_anel(void *arg) {
+    LacoEventos *laco = arg;
+    AnelIO *a = &laco->anel;
+    anel_armar_aceite(laco);
+    anel_armar_aviso(laco);
+
+    while (1) {
+        roda_avancar(&laco->roda, agora_us());
+        anel_armar_prazo(laco);
+
+        atomic_store(&laco->epoca, 0); // quiescente enquanto espera no anel
+        if (anel_submeter(a, 1) < 0 && errno != EINTR && errno != ETIME && errno != EBUSY)
+            perror("Erro no io_uring_enter");
+        atomic_store(&laco->epoca, atomic_load(&geracao_qos));
+
+        struct io_uring_cqe *cqe;
+        while ((cqe = anel_conclusao(a)) != NULL) {
+            uint64_t dado = cqe->user_data;
+            int res = cqe->res;
+            uint32_t flags = cqe->flags;
+            anel_avancar(a);
+            if (dado != 0) tratar_conclusao(laco, dado, res, flags);
+        }
+
+        tratar_expirados(laco);
+    }
     return NULL;
 }
 
-void enviar_arquivo(int sock, const char *nome_arquivo, double taxa_kBps) {
-    FILE *fp = fopen(nome_arquivo, "rb");
-    if (!fp) {
-        const char *msg = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
-        send(sock, msg, strlen(msg), 0);
+void tratar_conclusao(LacoEventos *laco, uint64_t dado, int res, uint32_t flags) {
+    OperacaoAnel op = (OperacaoAnel)(dado & OP_MASCARA);
+    switch (op) {
+    case OP_ACEITAR:
+        if (res >= 0) {
+            struct sockaddr_in addr;
+            socklen_t len = sizeof(addr);
+            Conexao *c = getpeername(res, (struct sockaddr *)&addr, &len) == 0 ? nova_conexao(laco, res, &addr) : NULL;
+            if (!c) {
+                close(res);
+            } else {
+                armar_prazo_leitura(laco, c);
+                metricas_contar(CONT_CONEXOES_ACEITAS, 1);
+                anel_receber(laco, c);
+            }
+        } else if (res != -EINTR && res != -ECANCELED) {
+            errno = -res;
+            perror("Erro no accept");
+        }
+        if (!(flags & IORING_CQE_F_MORE)) anel_armar_aceite(laco); // multishot encerrado pelo kernel
+        return;
+    case OP_AVISO:
+        receber_concessoes(laco);
+        if (!(flags & IORING_CQE_F_MORE)) anel_armar_aviso(laco);
+        return;
+    case OP_PRAZO:
+        laco->prazo_armado = UINT64_MAX; // a roda é avançada logo depois das conclusões
+        return;
+    default:
+        break;
+    }
+
+    Conexao *c = (Conexao *)(uintptr_t)(dado & ~(uint64_t)OP_MASCARA);
+    c->ops_anel--;
+    if (op == OP_LER && (flags & IORING_CQE_F_BUFFER)) {
+        uint16_t id = flags >> IORING_CQE_BUFFER_SHIFT;
+        if (res > 0 && !c->fechada && obter_req(laco, c)) { // o recv foi limitado ao espaço livre de 'req'
+            memcpy(c->req + c->req_len, anel_buffer(&laco->anel, id), res);
+            c->req_len += res;
+        }
+        anel_devolver_buffer(&laco->anel, id);
+    }
+    if (c->fechada) {
+        if (c->ops_anel == 0) slab_devolver(&laco->conexoes, c);
+        return;
+    }
+
+    switch (op) {
+    case OP_LER:
+        if (res == -ENOBUFS) { // todos os buffers em uso nesta volta: tenta de novo
+            anel_receber(laco, c);
+            return;
+        }
+        if (res < 0) {
+            fechar_conexao(laco, c);
+            return;
+        }
+        if (res == 0) c->fim_entrada = 1;
+        analisar_requisicao(laco, c);
         return;
+    case OP_ENVIAR:
+        if (res <= 0) {
+            fechar_conexao(laco, c);
+            return;
+        }
+        // Depois do cabeçalho: começo do corpo (sendmsg junto) ou cabeçalho de parte do
+        // multipart, cobrados do balde
+        size_t corpo = contar_cabecalho(c, res);
+        if (corpo > 0) {
+            if (c->faixas.partes)
+                c->parte_enviado += corpo;
+            else
+                envio_avancar(&c->envio, corpo);
+            balde_consumir(&c->balde, corpo);
+            c->janela_bytes += corpo;
+            metricas_contar(CONT_BYTES_ENVIADOS, corpo);
+        }
+        break;
+    case OP_ARQUIVO:
+        if (res <= 0) { // erro de leitura ou arquivo encolheu durante o envio
+            fechar_conexao(laco, c);
+            return;
+        }
+        c->envio.offset += res;
+        c->envio.no_pipe += res;
+        break;
+    case OP_ESPERA:
+        if (res < 0 && res != -ECANCELED) {
+            fechar_conexao(laco, c);
+            return;
+        }
+        break;
+    case OP_SOCKET:
+        if (res > 0) {
+            c->envio.no_pipe -= res;
+            if ((size_t)res < c->anel_pedido) c->janela_cheia = 1; // o socket encheu
+            balde_consumir(&c->balde, res);
+            c->janela_bytes += res;
+            metricas_contar(CONT_BYTES_ENVIADOS, res);
+        } else if (res == -EAGAIN) {
+            c->janela_cheia = 1;
+        } else if (res != -ECANCELED) { // cancelado: o elo anterior leu menos que o pedido
+            fechar_conexao(laco, c);
+            return;
+        }
+        break;
+    default:
+        break;
     }
+    // O último elo concluído continua o envio
+    if (c->ops_anel == 0 && c->estado == CONEXAO_ENVIANDO) anel_enviar_resposta(laco, c);
+}
+
+// Accept multishot: uma SQE entrega todas as conexões novas até o kernel encerrá-la
+void anel_armar_aceite(LacoEventos *laco) {
+    struct io_uring_sqe *sqe = anel_sqe(&laco->anel);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = laco->server_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC; // bloqueante: o anel espera sozinho por dados e espaço
+    sqe->user_data = dado_anel(laco, OP_ACEITAR);
+}
 
-    fseek(fp, 0, SEEK_END);
-    long tamanho = ftell(fp);
-    rewind(fp);
+void anel_armar_aviso(LacoEventos *laco) {
+    struct io_uring_sqe *sqe = anel_sqe(&laco->anel);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = laco->aviso_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = dado_anel(laco, OP_AVISO);
+}
 
-    char header[128];
-    sprintf(header, "HTTP/1.1 200 OK\r\nContent-Length: %ld\r\n\r\n", tamanho);
-    send(sock, header, strlen(header), 0);
+// Um único timeout absoluto acompanha o próximo prazo da roda (pausas do ritmo, ociosidade e
+// espera na fila); um prazo mais cedo atualiza o timeout em voo em vez de criar outro
+void anel_armar_prazo(LacoEventos *laco) {
+    uint64_t espera = roda_espera_us(&laco->roda);
+    if (espera == UINT64_MAX) return;
+    uint64_t prazo = agora_us() + espera;
+    if (prazo >= laco->prazo_armado) return; // o timeout em voo acorda antes
+    struct io_uring_sqe *sqe = anel_sqe(&laco->anel);
+    if (!sqe) return;
+    laco->prazo_ts.tv_sec = (int64_t)(prazo / 1000000);
+    laco->prazo_ts.tv_nsec = (long long)(prazo % 1000000) * 1000;
+    if (laco->prazo_armado == UINT64_MAX) {
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->addr = (uint64_t)(uintptr_t)&laco->prazo_ts;
+        sqe->len = 1;
+        sqe->user_data = dado_anel(laco, OP_PRAZO);
+    } else {
+        sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+        sqe->addr = dado_anel(laco, OP_PRAZO);
+        sqe->addr2 = (uint64_t)(uintptr_t)&laco->prazo_ts;
+        sqe->timeout_flags = IORING_TIMEOUT_UPDATE;
+        sqe->user_data = 0; // se o antigo já disparou, a conclusão dele rearma
+    }
+    sqe->fd = -1;
+    sqe->timeout_flags |= IORING_TIMEOUT_ABS; // CLOCK_MONOTONIC, o mesmo de agora_us
+    laco->prazo_armado = prazo;
+}
 
-    char buf[BUF_SIZE];
-    size_t bytes;
-    useconds_t atraso = (useconds_t)(1000000 * (BUF_SIZE / 1024.0) / taxa_kBps);
+// Recv com buffer escolhido pelo kernel, limitado ao espaço que resta em 'req'
+void anel_receber(LacoEventos *laco, Conexao *c) {
+    struct io_uring_sqe *sqe = anel_sqe(&laco->anel);
+    if (!sqe) {
+        fechar_conexao(laco, c);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->sock;
+    sqe->len = (uint32_t)(BUF_SIZE - c->req_len);
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = laco->anel.buf_grupo;
+    sqe->user_data = dado_anel(c, OP_LER);
+    c->ops_anel++;
+}
 
-    while ((bytes = fread(buf, 1, sizeof(buf), fp)) > 0) {
-        send(sock, buf, bytes, 0);
-        usleep(atraso);
+void anel_enviar(LacoEventos *laco, Conexao *c, const char *dados, size_t len) {
+    struct io_uring_sqe *sqe = anel_sqe(&laco->anel);
+    if (!sqe) {
+        fechar_conexao(laco, c);
+        return;
     }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = c->sock;
+    sqe->addr = (uint64_t)(uintptr_t)dados;
+    sqe->len = (uint32_t)len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = dado_anel(c, OP_ENVIAR);
+    c->ops_anel++;
+    armar_prazo_escrita(laco, c);
+}
 
-    fclose(fp);
+// enviar_junto no anel: o msghdr fica na conexão até a conclusão
+void anel_enviar_junto(LacoEventos *laco, Conexao *c, size_t fichas) {
+    struct io_uring_sqe *sqe = anel_sqe(&laco->anel);
+    if (!sqe) {
+        fechar_conexao(laco, c);
+        return;
+    }
+    size_t junto = fichas < TRECHO_JUNTO_MAX ? fichas : TRECHO_JUNTO_MAX;
+    if ((off_t)junto > envio_restante(&c->envio)) junto = (size_t)envio_restante(&c->envio);
+    c->iov[0] = (struct iovec){ (char *)c->resp_ptr + c->resp_enviado, c->resp_len - c->resp_enviado };
+    c->iov[1] = (struct iovec){ (char *)c->rep->dados + c->envio.offset, junto };
+    c->msg = (struct msghdr){ .msg_iov = c->iov, .msg_iovlen = 2 };
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = c->sock;
+    sqe->addr = (uint64_t)(uintptr_t)&c->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = dado_anel(c, OP_ENVIAR);
+    c->ops_anel++;
+    armar_prazo_escrita(laco, c);
 }
 
-int buscar_cliente(const char *ip) {
-    for (int i = 0; i < MAX_CLIENTES; i++)
-        if (clientes[i].ativo && strcmp(clientes[i].ip, ip) == 0)
-            return i;
-    return -1;
+// Até 'max' bytes do corpo numa cadeia ligada: arquivo -> pipe, espera o socket aceitar dados,
+// pipe -> socket. O que sobrar no pipe (envio parcial ou elo cancelado) sai na próxima cadeia
+void anel_transmitir(LacoEventos *laco, Conexao *c, size_t max) {
+    EnvioArquivo *e = &c->envio;
+    AnelIO *a = &laco->anel;
+    struct io_uring_sqe *sqe[3];
+    int n = e->no_pipe == 0 ? 3 : 2;
+    if (a->sq_entradas - (*a->sq_tail - __atomic_load_n(a->sq_head, __ATOMIC_ACQUIRE)) < (unsigned)n)
+        anel_submeter(a, 0); // a cadeia não pode ser partida entre duas submissões
+    for (int k = 0; k < n; k++) {
+        if (!(sqe[k] = anel_sqe(a))) {
+            // Cadeia incompleta: as SQEs já preenchidas viram no-ops sem conexão
+            for (int j = 0; j < k; j++) {
+                sqe[j]->opcode = IORING_OP_NOP;
+                sqe[j]->flags = 0;
+                sqe[j]->user_data = 0;
+            }
+            fechar_conexao(laco, c);
+            return;
+        }
+    }
+
+    size_t len = e->no_pipe;
+    int k = 0;
+    if (n == 3) {
+        len = max;
+        if ((off_t)len > e->fim - e->offset) len = (size_t)(e->fim - e->offset);
+        if (len > CAPACIDADE_PIPE) len = CAPACIDADE_PIPE;
+        sqe[k]->opcode = IORING_OP_SPLICE;
+        sqe[k]->fd = e->pipe_fd[1];
+        sqe[k]->off = (uint64_t)-1;
+        sqe[k]->splice_fd_in = e->fd;
+        sqe[k]->splice_off_in = (uint64_t)e->offset;
+        sqe[k]->len = (uint32_t)len;
+        sqe[k]->splice_flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+        sqe[k]->flags = IOSQE_IO_LINK;
+        sqe[k]->user_data = dado_anel(c, OP_ARQUIVO);
+        k++;
+    } else if (len > max) {
+        len = max;
+    }
+
+    sqe[k]->opcode = IORING_OP_POLL_ADD;
+    sqe[k]->fd = c->sock;
+    sqe[k]->poll32_events = POLLOUT;
+    sqe[k]->flags = IOSQE_IO_LINK;
+    sqe[k]->user_data = dado_anel(c, OP_ESPERA);
+    k++;
+
+    // Não bloqueante: escreve o que couber no socket (o poll garantiu espaço). SPLICE_F_MORE só
+    // antes do fim da faixa: no último trecho seguraria o segmento final até o timer do TCP
+    sqe[k]->opcode = IORING_OP_SPLICE;
+    sqe[k]->fd = c->sock;
+    sqe[k]->off = (uint64_t)-1;
+    sqe[k]->splice_fd_in = e->pipe_fd[0];
+    sqe[k]->splice_off_in = (uint64_t)-1;
+    sqe[k]->len = (uint32_t)len;
+    sqe[k]->splice_flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+    if (envio_restante(e) > (off_t)len) sqe[k]->splice_flags |= SPLICE_F_MORE;
+    sqe[k]->user_data = dado_anel(c, OP_SOCKET);
+
+    c->anel_pedido = len;
+    c->ops_anel += n;
+    armar_prazo_escrita(laco, c);
 }
 
-int registrar_cliente(const char *ip) {
-    for (int i = 0; i < MAX_CLIENTES; i++) {
-        if (!clientes[i].ativo) {
-            strcpy(clientes[i].ip, ip);
-            clientes[i].ativo = 1;
-            clientes[i].last_rtt = 0.0;
-            clientes[i].last_bandwidth = 0.0;
-            clientes[i].requisicoes = 0;
-            gettimeofday(&clientes[i].last_request_time, NULL);
-            return i;
+// enviar_resposta no motor io_uring: no máximo uma operação (ou cadeia) em voo por conexão; a
+// conclusão dela chama esta função de novo até o fim da resposta
+void anel_enviar_resposta(LacoEventos *laco, Conexao *c) {
+    if (c->ops_anel > 0) return;
+    if (c->resp_enviado < c->resp_len && !juntar_cabecalho(c)) {
+        anel_enviar(laco, c, c->resp_ptr + c->resp_enviado, c->resp_len - c->resp_enviado);
+        return;
+    }
+
+    if (c->versao == NULL || c->cabeca) {
+        concluir_resposta(laco, c);
+        return;
+    }
+
+    if (atualizar_em_andamento && c->geracao_qos != atomic_load(&geracao_qos))
+        atualizar_taxa(c);
+    if (redistribuir) acompanhar_alocacao(c);
+
+    if (envio_preparar_pipe(&c->envio) != 0) {
+        fechar_conexao(laco, c);
+        return;
+    }
+    if (c->faixas.partes) tampar(c, 1);
+    for (;;) {
+        RespostaFaixas *r = &c->faixas;
+        if (r->partes) {
+            size_t fim = r->parte_ini[c->faixa_atual + 1];
+            size_t pos = r->parte_ini[c->faixa_atual] + c->parte_enviado;
+            if (pos < fim) {
+                anel_enviar(laco, c, r->partes + pos, fim - pos);
+                return;
+            }
+        }
+        if (!envio_concluido(&c->envio)) {
+            size_t fichas;
+            if (aguardar_fichas(laco, c, &fichas)) return;
+            if (c->resp_enviado < c->resp_len)
+                anel_enviar_junto(laco, c, fichas);
+            else
+                anel_transmitir(laco, c, fichas);
+            return;
         }
+        if (!proxima_faixa(c)) break;
     }
-    return -1;
+    finalizar_requisicao(laco, c);
+}
+
+// Sem trava: vai para o anel da thread e é gravado em disco em segundo plano
+void registrar_requisicao(Conexao *c, double rtt, double banda, int rejeitada) {
+    uint8_t ip[16];
+    clientes_chave_v4(c->ip_bin, ip);
+    historico_registrar(ip, rtt, banda, rejeitada);
+}
+
+uint64_t agora_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
 double calcular_tempo(struct timeval inicio, struct timeval fim) {
     return (fim.tv_sec - inicio.tv_sec) + (fim.tv_usec - inicio.tv_usec) / 1e6;
 }
 
+// Descarta as estatísticas de clientes ociosos (as métricas ficam em GET /metrics)
 void *monitorar_clientes(void *arg) {
     (void)arg;
 
     while (1) {
-        pthread_mutex_lock(&lock);
-        printf("\033[H\033[J"); // Limpa tela
-        printf("=== HISTÓRICO DE REQUISIÇÕES ===\n");
-        printf("%-4s | %-15s | %-8s | %-12s | %-10s\n", 
-               "ID", "IP", "RTT(s)", "Banda(kB/s)", "Thread");
-        printf("--------------------------------------------------------------------\n");
-
-        for (int i = 0; i < requisicao_count; i++) {
-            printf("%-4d | %-15s | %-8.3f | %-12.2f | %lu%s\n",
-                   requisicoes[i].id_requisicao,
-                   requisicoes[i].ip,
-                   requisicoes[i].rtt,
-                   requisicoes[i].bandwidth,
-                   (unsigned long)requisicoes[i].thread_id,
-                   requisicoes[i].rejeitada ? "  [REJEITADA]" : "");
-        }
-
-        printf("Vazão atual do servidor: %.2f / %.2f kB/s\n", vazao_atual, vazao_maxima);
-
-        pthread_mutex_unlock(&lock);
         sleep(1);
+        for (int i = 0; i < num_lacos; i++) {
+            clientes_expirar(lacos[i].clientes, agora_us(), CLIENTE_OCIOSO_S * 1000000ULL);
+            if (!escuta_por_nucleo) break; // todas as threads na mesma tabela
+        }
     }
     return NULL;
 }
 
-long tamanho_arquivo_kb(const char *nome_arquivo) {
-    struct stat st;
-    if (stat(nome_arquivo, &st) != 0) return -1;
-    return st.st_size / 1024;
+size_t total_clientes(void) {
+    size_t total = 0;
+    for (int i = 0; i < (escuta_por_nucleo ? num_lacos : 1); i++)
+        total += clientes_total(lacos[i].clientes);
+    return total;
 }
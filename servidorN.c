@@ -12,6 +12,8 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 
+#include "orcamento_banda.h"
+
 #define PORTA_PADRAO 5000
 #define MAX_CLIENTES 100
 #define BUF_SIZE 4096
@@ -39,7 +41,7 @@ QoS_IP qos_ips[MAX_QOS];
 int qos_count = 0;
 
 double vazao_max = 10000; // kB/s
-double vazao_atual = 0.0;
+OrcamentoBanda orcamento; // reservas das conexões ativas (sem trava)
 
 // Funções
 void *atender_cliente(void *arg);
@@ -52,7 +54,7 @@ double buscar_taxa_ip(const char *ip);
 void carregar_qos(const char *arquivo_qos);
 long tamanho_arquivo_kb(const char *nome_arquivo);
 void log_requisicao(const char *ip, double rtt, double banda, int req, pthread_t tid);
-int pode_aceitar(double banda_solicitada);
+int reservar_banda(double banda_solicitada);
 
 int main(int argc, char *argv[]) {
     int server_fd;
@@ -62,6 +64,7 @@ int main(int argc, char *argv[]) {
     int porta = (argc > 1) ? atoi(argv[1]) : PORTA_PADRAO;
     const char *arquivo_qos = (argc > 2) ? argv[2] : "ips.txt";
     vazao_max = (argc > 3) ? atof(argv[3]) : 10000;
+    orcamento_iniciar(&orcamento, vazao_max);
 
     // Inicializa clientes
     for (int i = 0; i < MAX_CLIENTES; i++)
@@ -146,12 +149,10 @@ double buscar_taxa_ip(const char *ip) {
     return TX_PADRAO;
 }
 
-// Verifica se pode aceitar nova requisição sem ultrapassar vazão
-int pode_aceitar(double banda_solicitada) {
-    pthread_mutex_lock(&lock);
-    int resultado = (vazao_atual + banda_solicitada <= vazao_max);
-    pthread_mutex_unlock(&lock);
-    return resultado;
+// Verifica e reserva a banda numa única operação atômica: duas threads não podem
+// passar pela verificação juntas e ultrapassar a vazão
+int reservar_banda(double banda_solicitada) {
+    return orcamento_reservar(&orcamento, orcamento_Bps(banda_solicitada));
 }
 
 // Atendimento de cada cliente
@@ -170,17 +171,16 @@ void *atender_cliente(void *arg) {
 
     double taxa_cliente = buscar_taxa_ip(ip_cliente);
 
-    if (!pode_aceitar(taxa_cliente)) {
+    if (!reservar_banda(taxa_cliente)) {
         pthread_mutex_lock(&print_lock);
         printf("Rejeitado: %s - limite de banda atingido (%.2f / %.2f kB/s)\n",
-               ip_cliente, vazao_atual, vazao_max);
+               ip_cliente, orcamento_usado_kBps(&orcamento), vazao_max);
         pthread_mutex_unlock(&print_lock);
         close(sock);
         return NULL;
     }
 
     pthread_mutex_lock(&lock);
-    vazao_atual += taxa_cliente;
     int idx = buscar_cliente(ip_cliente);
     if (idx == -1) idx = registrar_cliente(ip_cliente);
     pthread_mutex_unlock(&lock);
@@ -189,7 +189,7 @@ void *atender_cliente(void *arg) {
     ssize_t n = read(sock, buffer, sizeof(buffer) - 1);
     if (n <= 0) {
         close(sock);
-        pthread_mutex_lock(&lock); vazao_atual -= taxa_cliente; pthread_mutex_unlock(&lock);
+        orcamento_liberar(&orcamento, orcamento_Bps(taxa_cliente));
         return NULL;
     }
     buffer[n] = '\0';
@@ -207,7 +207,7 @@ void *atender_cliente(void *arg) {
         const char *msg = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
         send(sock, msg, strlen(msg), 0);
         close(sock);
-        pthread_mutex_lock(&lock); vazao_atual -= taxa_cliente; pthread_mutex_unlock(&lock);
+        orcamento_liberar(&orcamento, orcamento_Bps(taxa_cliente));
         return NULL;
     }
 
@@ -227,8 +227,8 @@ void *atender_cliente(void *arg) {
     cli->last_request_time = inicio;
     cli->requisicoes++;
     cli->thread_id = pthread_self();
-    vazao_atual -= taxa_cliente;
     pthread_mutex_unlock(&lock);
+    orcamento_liberar(&orcamento, orcamento_Bps(taxa_cliente));
 
     log_requisicao(ip_cliente, cli->last_rtt, cli->last_bandwidth, cli->requisicoes, cli->thread_id);
 
@@ -329,7 +329,7 @@ void *monitorar_clientes(void *arg) {
                        (unsigned long)clientes[i].thread_id);
             }
         }
-        printf("Vazão atual do servidor: %.2f / %.2f kB/s\n", vazao_atual, vazao_max);
+        printf("Vazão atual do servidor: %.2f / %.2f kB/s\n", orcamento_usado_kBps(&orcamento), vazao_max);
         pthread_mutex_unlock(&lock);
         pthread_mutex_unlock(&print_lock);
     }
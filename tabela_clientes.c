@@ -0,0 +1,147 @@
+// tabela_clientes.c
+// Estatísticas por cliente em uma tabela hash particionada com descarte LRU
+
+#include "tabela_clientes.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t hash_ip(const uint8_t ip[16]) {
+    uint64_t a, b;
+    memcpy(&a, ip, 8);
+    memcpy(&b, ip + 8, 8);
+    // Finalizador do murmur3 sobre as duas metades
+    uint64_t h = a ^ (b * 0x9e3779b97f4a7c15ULL);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static ShardClientes *shard_de(TabelaClientes *t, uint64_t h) {
+    return &t->shards[h >> 58]; // 6 bits altos: CLIENTES_SHARDS == 64
+}
+
+int clientes_iniciar(TabelaClientes *t, size_t capacidade) {
+    size_t por_shard = capacidade / CLIENTES_SHARDS;
+    if (por_shard < 1) por_shard = 1;
+    size_t num_baldes = 1;
+    while (num_baldes < por_shard) num_baldes <<= 1;
+
+    for (int i = 0; i < CLIENTES_SHARDS; i++) {
+        ShardClientes *s = &t->shards[i];
+        pthread_mutex_init(&s->trava, NULL);
+        s->baldes = calloc(num_baldes, sizeof(ClienteInfo *));
+        s->reserva = calloc(por_shard, sizeof(ClienteInfo));
+        if (!s->baldes || !s->reserva) return -1;
+        s->usados_reserva = 0;
+        s->livres = NULL;
+        s->mascara = num_baldes - 1;
+        s->num = 0;
+        s->capacidade = por_shard;
+        s->lru_cabeca = s->lru_cauda = NULL;
+    }
+    return 0;
+}
+
+void clientes_chave_v4(uint32_t ip, uint8_t chave[16]) {
+    memset(chave, 0, 10);
+    chave[10] = chave[11] = 0xff;
+    chave[12] = ip >> 24;
+    chave[13] = ip >> 16;
+    chave[14] = ip >> 8;
+    chave[15] = ip;
+}
+
+static void lru_remover(ShardClientes *s, ClienteInfo *c) {
+    if (c->lru_ant) c->lru_ant->lru_prox = c->lru_prox;
+    else s->lru_cabeca = c->lru_prox;
+    if (c->lru_prox) c->lru_prox->lru_ant = c->lru_ant;
+    else s->lru_cauda = c->lru_ant;
+}
+
+static void lru_inserir_cabeca(ShardClientes *s, ClienteInfo *c) {
+    c->lru_ant = NULL;
+    c->lru_prox = s->lru_cabeca;
+    if (s->lru_cabeca) s->lru_cabeca->lru_ant = c;
+    else s->lru_cauda = c;
+    s->lru_cabeca = c;
+}
+
+static void hash_remover(ShardClientes *s, ClienteInfo *c) {
+    ClienteInfo **p = &s->baldes[hash_ip(c->ip) & s->mascara];
+    while (*p != c) p = &(*p)->prox_hash;
+    *p = c->prox_hash;
+}
+
+ClienteInfo *clientes_obter(TabelaClientes *t, const uint8_t ip[16], uint64_t agora_us) {
+    uint64_t h = hash_ip(ip);
+    ShardClientes *s = shard_de(t, h);
+    pthread_mutex_lock(&s->trava);
+
+    ClienteInfo **balde = &s->baldes[h & s->mascara];
+    ClienteInfo *c = *balde;
+    while (c && memcmp(c->ip, ip, 16) != 0) c = c->prox_hash;
+
+    if (c) {
+        lru_remover(s, c);
+    } else {
+        if (s->num >= s->capacidade) {
+            // Shard cheio: reaproveita o cliente usado há mais tempo
+            c = s->lru_cauda;
+            lru_remover(s, c);
+            hash_remover(s, c);
+        } else if (s->livres) {
+            c = s->livres;
+            s->livres = c->prox_hash;
+            s->num++;
+        } else { // num < capacidade: ainda há entradas nunca usadas na reserva
+            c = &s->reserva[s->usados_reserva++];
+            s->num++;
+        }
+        memset(c, 0, sizeof(*c));
+        memcpy(c->ip, ip, 16);
+        gettimeofday(&c->last_request_time, NULL);
+        c->prox_hash = *balde;
+        *balde = c;
+    }
+    c->ultimo_uso_us = agora_us;
+    lru_inserir_cabeca(s, c);
+    return c;
+}
+
+void clientes_soltar(TabelaClientes *t, ClienteInfo *cli) {
+    pthread_mutex_unlock(&shard_de(t, hash_ip(cli->ip))->trava);
+}
+
+size_t clientes_expirar(TabelaClientes *t, uint64_t agora_us, uint64_t ocioso_us) {
+    size_t removidos = 0;
+    for (int i = 0; i < CLIENTES_SHARDS; i++) {
+        ShardClientes *s = &t->shards[i];
+        pthread_mutex_lock(&s->trava);
+        // A cauda é sempre o menos recente: para no primeiro ainda ativo
+        while (s->lru_cauda && agora_us - s->lru_cauda->ultimo_uso_us > ocioso_us) {
+            ClienteInfo *c = s->lru_cauda;
+            lru_remover(s, c);
+            hash_remover(s, c);
+            c->prox_hash = s->livres;
+            s->livres = c;
+            s->num--;
+            removidos++;
+        }
+        pthread_mutex_unlock(&s->trava);
+    }
+    return removidos;
+}
+
+size_t clientes_total(TabelaClientes *t) {
+    size_t total = 0;
+    for (int i = 0; i < CLIENTES_SHARDS; i++) {
+        pthread_mutex_lock(&t->shards[i].trava);
+        total += t->shards[i].num;
+        pthread_mutex_unlock(&t->shards[i].trava);
+    }
+    return total;
+}
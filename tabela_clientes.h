@@ -0,0 +1,55 @@
+// tabela_clientes.h
+// Estatísticas por cliente em uma tabela hash particionada em shards, cada um com sua trava.
+// Memória limitada e reservada ao iniciar: cada shard tem a sua reserva de entradas, sem malloc/free
+// a cada cliente novo. Ao atingir a capacidade, o shard reaproveita o cliente usado há mais tempo
+// (LRU); clientes sem requisição há muito tempo também são descartados periodicamente
+
+#ifndef TABELA_CLIENTES_H
+#define TABELA_CLIENTES_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#define CLIENTES_SHARDS 64
+
+typedef struct ClienteInfo {
+    uint8_t ip[16];             // endereço binário (IPv4 mapeado em IPv6)
+    double last_rtt;
+    double last_bandwidth;
+    struct timeval last_request_time;
+    int requisicoes;
+    pthread_t thread_id;
+
+    uint64_t ultimo_uso_us;     // base do descarte por ociosidade
+    struct ClienteInfo *prox_hash;
+    struct ClienteInfo *lru_ant, *lru_prox; // cabeça = mais recente
+} ClienteInfo;
+
+typedef struct {
+    pthread_mutex_t trava;
+    ClienteInfo **baldes;
+    size_t mascara;             // num_baldes - 1
+    size_t num, capacidade;
+    ClienteInfo *lru_cabeca, *lru_cauda;
+    ClienteInfo *reserva;       // 'capacidade' entradas; as páginas só são tocadas quando usadas
+    size_t usados_reserva;      // entradas da reserva já entregues alguma vez
+    ClienteInfo *livres;        // descartadas por ociosidade, ligadas por prox_hash
+} ShardClientes;
+
+typedef struct {
+    ShardClientes shards[CLIENTES_SHARDS];
+} TabelaClientes;
+
+// 'capacidade' é o total de clientes guardados, dividido igualmente entre os shards
+int clientes_iniciar(TabelaClientes *t, size_t capacidade);
+void clientes_chave_v4(uint32_t ip, uint8_t chave[16]);
+// Retorna o cliente (criado se não existir) com o shard travado; devolver com clientes_soltar
+ClienteInfo *clientes_obter(TabelaClientes *t, const uint8_t ip[16], uint64_t agora_us);
+void clientes_soltar(TabelaClientes *t, ClienteInfo *cli);
+// Descarta clientes sem uso há mais de 'ocioso_us'. Retorna quantos foram descartados
+size_t clientes_expirar(TabelaClientes *t, uint64_t agora_us, uint64_t ocioso_us);
+size_t clientes_total(TabelaClientes *t);
+
+#endif
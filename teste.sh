@@ -1,30 +1,34 @@
 #!/bin/bash
 
-# Configurações 
-NUM_REQUESTS=10 # Quantas requisições concorrentes você quer fazer
-URL="http://localhost:5000"
+# Configurações
+CONEXOES=10        # Quantas conexões simultâneas
+DURACAO=10         # Segundos de teste
+HOST="localhost"
+PORTA=5000
+ORIGENS="127.0.0.1 127.0.0.2"  # IPs de origem (exercitam as regras do qos_config.txt)
+RESULTADO="resultado.json"
 # Fim config
 
-echo "Iniciando $NUM_REQUESTS requisições concorrentes para $URL..."
+# Compila o gerador de carga se ainda não existe (ou se o código mudou)
+if [ ! -x gerador_carga ] || [ gerador_carga.c -nt gerador_carga ]; then
+  gcc -O2 gerador_carga.c qos.c -o gerador_carga -lpthread || exit 1
+fi
 
-# Cria uma pasta para salvar os arquivos, se não existir
-mkdir -p downloads
-rm -f downloads/* # Limpa downloads anteriores
+# Cada arquivo publicado em rotas.txt é pedido e conferido byte a byte
+CAMINHOS=()
+while read -r caminho arquivo; do
+  case "$caminho" in ""|\#*) continue ;; esac
+  [ -f "$arquivo" ] && CAMINHOS+=(-p "$caminho=$arquivo")
+done < rotas.txt
 
-# Loop para lançar todos os comandos curl em segundo plano
-for i in $(seq 1 $NUM_REQUESTS)
-do
-  echo "  -> Lançando requisição #$i"
-  # O '&' executa o comando em segundo plano
-  # o script continua para o próximo passo imediatamente.
-  curl -s -o "downloads/foto_$i.jpg" $URL &
-done
+IPS=()
+for ip in $ORIGENS; do IPS+=(-i "$ip"); done
 
-echo
-echo "Aguardando todas as requisições em segundo plano terminarem..."
-#pausa o script até que todos os processos em segundo plano terminem
-wait
+echo "Gerando carga em $HOST:$PORTA com $CONEXOES conexões por $DURACAO s..."
+./gerador_carga -c "$CONEXOES" -d "$DURACAO" "${CAMINHOS[@]}" "${IPS[@]}" \
+  -q qos_config.txt -o "$RESULTADO" "$HOST" "$PORTA"
+status=$?
 
 echo
-echo "Concluído! Verifique os arquivos na pasta 'downloads'."
-ls -l downloads
\ No newline at end of file
+echo "Resultados em $RESULTADO"
+exit $status